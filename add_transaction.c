@@ -7,6 +7,12 @@
 int main(void)
 {
     char sender[DATASIZE_MAX], receiver[DATASIZE_MAX], amount[20]; /* They are all strings */
+    char fee[24];
+    char *end;
+    uint64_t feeValue;
+    blockchain_ctx_t ctx;
+    int saved;
+
     printf("Sender: ");
     if (!fgets(sender, sizeof(sender), stdin))
     {
@@ -28,16 +34,37 @@ int main(void)
         exit(EXIT_FAILURE);
     }
 
+    printf("Fee: ");
+    if (!fgets(fee, sizeof(fee), stdin))
+        fee[0] = '\0';  /* no fee given */
+
     /* Removing newlines */
     sender[strcspn(sender, "\n")] = '\0';
     receiver[strcspn(receiver, "\n")] = '\0';
     amount[strcspn(amount, "\n")] = '\0';
+    fee[strcspn(fee, "\n")] = '\0';
 
-    if (!addTransactionToUnspent(sender, receiver, amount))
+    feeValue = strtoull(fee, &end, 10);
+    if (*end != '\0' || fee[0] == '-')
+    {
+        printf("Error: invalid fee.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!initContext(&ctx, NULL))
+    {
+        fprintf(stderr, "Could not set up blockchain context: %s\n", blockchainStrerror(blockchainError()));
+        exit(EXIT_FAILURE);
+    }
+    ctx.log = stderr;
+    saved = addTransactionToUnspent(&ctx, sender, receiver, amount, feeValue);
+    if (!saved)
     {
-        fprintf(stderr, "Could not add transactions to unspent pool\n");
+        fprintf(stderr, "Could not add transactions to unspent pool: %s\n", blockchainStrerror(blockchainError()));
         exit(EXIT_FAILURE);
     }
+    closeContext(&ctx);
+    printf(saved == 1 ? "Transaction saved!\n" : "Transaction queued!\n");
 
     return 0;
 }
\ No newline at end of file
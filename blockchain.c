@@ -5,52 +5,29 @@
  * @sender: sender details
  * @receiver: receiver details
  * @amount: transaction amount
+ * Return: pointer to list or NULL on failure
  */
 list_of_transactions *createTransactions(const char *sender, const char *receiver, const char *amount)
 {
-    list_of_transactions *new_list;
-    transaction_t *new_trans = (transaction_t *)malloc(sizeof(transaction_t));
-    if (!new_trans)
-    {
-        perror("Could not allocate memory for transaction");
-        exit(EXIT_FAILURE);
-    }
-    strncpy(new_trans->sender, sender, DATASIZE_MAX - 1);
-    new_trans->sender[DATASIZE_MAX - 1] = '\0';
-    
-    strncpy(new_trans->receiver, receiver, DATASIZE_MAX - 1);
-    new_trans->receiver[DATASIZE_MAX - 1] = '\0';
-    
-    strncpy(new_trans->amount, amount, sizeof(new_trans->amount) - 1);
-    new_trans->amount[sizeof(new_trans->amount) - 1] = '\0';
-
-    new_trans->next = NULL;
-    new_trans->index = 0;
-
-    new_list = (list_of_transactions *)malloc(sizeof(list_of_transactions));
+    list_of_transactions *new_list = newTransactions(1);
     if (!new_list)
-    {
-        perror("Could not allocate memory for data");
-        free(new_trans);
-        exit(EXIT_FAILURE);
-    }
-    new_list->head = new_trans;
-    new_list->tail = new_trans;
-    new_list->nb_trans = 1;
+        return NULL;
+    appendTransaction(new_list, sender, receiver, amount, 0);
     return new_list;
 }
 
 /**
- * createBlock - creates new block
+ * prepareBlock - creates new block template, ready to be mined
+ * @index: height of block
  * @transactions: pointer to transactions to add to block
  * @prevHash: previous block hash
- * @difficulty: Proof of Work difficulty level
+ * Return: pointer to block or NULL on failure
  */
-block_t *createBlock(int index, list_of_transactions *transactions, const unsigned char *prevHash, int difficulty)
+block_t *prepareBlock(int index, list_of_transactions *transactions, const unsigned char *prevHash)
 {
     block_t *newBlock = (block_t *)malloc(sizeof(block_t));
     if (!newBlock) {
-        printf("Failed to allocate memory for block\n");
+        blockchainFail(BC_ENOMEM);
         return NULL;
     }
 
@@ -62,72 +39,151 @@ block_t *createBlock(int index, list_of_transactions *transactions, const unsign
     else
         memset(newBlock->prevHash, 0, SHA256_DIGEST_LENGTH); 
     memset(newBlock->currHash, 0, SHA256_DIGEST_LENGTH);
-    newBlock->next = NULL;
     newBlock->nonce = 0;
+    return newBlock;
+}
 
-    mine_block(newBlock, difficulty);
-    list_of_transactions *new_unspent = calloc(1, sizeof(*new_unspent));
-    if (!new_unspent)
+/**
+ * createBlock - creates new block and mines it
+ * @ctx: pointer to context
+ * @index: height of block
+ * @transactions: pointer to transactions to add to block
+ * @prevHash: previous block hash
+ * @difficulty: Proof of Work difficulty level
+ * Return: pointer to mined block or NULL on failure, the transactions stay
+ * with the caller
+ */
+block_t *createBlock(blockchain_ctx_t *ctx, int index, list_of_transactions *transactions, const unsigned char *prevHash, int difficulty)
+{
+    block_t *newBlock = prepareBlock(index, transactions, prevHash);
+    if (newBlock && !mine_block(ctx, newBlock, difficulty))
     {
         free(newBlock);
-        printf("Could not allocated memory for new unspent\n");
-        return NULL;
+        newBlock = NULL;
     }
-    if (!serializeUnspent(new_unspent))
+    return newBlock;
+}
+
+/**
+ * newBlockchain - allocates an empty blockchain
+ * @difficulty: PoW difficulty level
+ * Return: pointer to blockchain or NULL on failure
+ */
+Blockchain *newBlockchain(int difficulty)
+{
+    Blockchain *blockchain = calloc(1, sizeof(Blockchain));
+    if (!blockchain)
     {
-        printf("Could not serialize new unspent\n");
-        free(newBlock);
+        blockchainFail(BC_ENOMEM);
         return NULL;
     }
-    return newBlock;
+    blockchain->difficulty = difficulty;
+    return blockchain;
+}
+
+/**
+ * reserveBlocks - grows the block array of a blockchain
+ * @blockchain: pointer to blockchain
+ * @capacity: minimum number of blocks the chain must hold
+ * Return: 1 on success else 0
+ */
+int reserveBlocks(Blockchain *blockchain, int capacity)
+{
+    block_t *blocks;
+    int cap;
+
+    if (capacity <= blockchain->capacity)
+        return 1;
+    cap = blockchain->capacity ? blockchain->capacity : 16;
+    while (cap < capacity)
+        cap *= 2;
+    blocks = realloc(blockchain->blocks, cap * sizeof(*blocks));
+    if (!blocks)
+        return blockchainFail(BC_ENOMEM);
+    blockchain->blocks = blocks;
+    blockchain->capacity = cap;
+    return 1;
+}
+
+/**
+ * getBlock - gets the block at a given height
+ * @blockchain: pointer to blockchain
+ * @height: height of block, 0 being genesis
+ * Return: pointer to block, valid until the next addBlock, or NULL
+ */
+block_t *getBlock(Blockchain *blockchain, int height)
+{
+    if (!blockchain || height < 0 || height >= blockchain->length)
+        return NULL;
+    return &blockchain->blocks[height];
 }
 
 /**
  * addBlock - adds block to blockchain
  * @blockchain: pointer to blockchain
- * @block: pointer to mined block
- * Return: Nothing
+ * @block: pointer to mined block, its header is copied into the chain and
+ * the block itself freed; the chain takes over its transactions
+ * Return: 1 on success else 0
  */
-void addBlock(Blockchain *blockchain, block_t *block)
+int addBlock(Blockchain *blockchain, block_t *block)
 {
     if (!block)
-        return;
-    if (!blockchain->head)
-        blockchain->head = blockchain->tail = block;
-    else
-    {
-        blockchain->tail->next = block;
-        blockchain->tail = block;
-    }
-    blockchain->length++;
+        return blockchainFail(BC_EINVAL);
+    if (!reserveBlocks(blockchain, blockchain->length + 1))
+        return 0;
+    blockchain->blocks[blockchain->length++] = *block;
+    free(block);
+    return 1;
 }
 
 
 /**
  * initBlockchain - initializes new blockchain with genesis block
- * Return: pointer to blockchain
+ * @ctx: pointer to context
+ * Return: pointer to blockchain or NULL on failure
  */
-Blockchain *initBlockchain(void)
+Blockchain *initBlockchain(blockchain_ctx_t *ctx)
 {
-    Blockchain *blockchain = (Blockchain *)malloc(sizeof(Blockchain));
-    if (!blockchain) {
-        perror("Failed to allocate memory for blockchain");
-        exit(EXIT_FAILURE);
-    }
-
-    blockchain->difficulty = INITIAL_DIFFICULTY;
+    Blockchain *blockchain = newBlockchain(INITIAL_DIFFICULTY);
+    if (!blockchain)
+        return NULL;
 
     // Create the genesis block
     list_of_transactions *genesis_transactions = createTransactions("Genesis", "Blockchain", "0");
     unsigned char genesisHash[SHA256_DIGEST_LENGTH] = {0};
-    block_t *genesisBlock = createBlock(0, genesis_transactions, genesisHash, blockchain->difficulty);
+    block_t *genesisBlock = genesis_transactions ?
+        createBlock(ctx, 0, genesis_transactions, genesisHash, blockchain->difficulty) : NULL;
 
-    blockchain->head = blockchain->tail = genesisBlock;
-    blockchain->length = 1;
+    if (!genesisBlock || !addBlock(blockchain, genesisBlock))
+    {
+        free(genesisBlock);
+        freeTransactions(genesis_transactions);
+        freeBlockchain(blockchain);
+        return NULL;
+    }
 
     return blockchain;
 }
 
+/**
+ * validateBlock - checks a block's hash and its link to the previous block
+ * @blockchain: pointer to blockchain
+ * @height: height of block to check
+ * Return: 1 if valid, or 0 if invalid
+ */
+int validateBlock(Blockchain *blockchain, int height)
+{
+    static const unsigned char genesisPrevHash[SHA256_DIGEST_LENGTH] = {0};
+    unsigned char calculatedHash[SHA256_DIGEST_LENGTH];
+    block_t *current = getBlock(blockchain, height);
+    const unsigned char *prevHash = height > 0 ? blockchain->blocks[height - 1].currHash : genesisPrevHash;
+
+    if (!current || !calculateHash(current, current->nonce, calculatedHash))
+        return 0;
+    return memcmp(current->currHash, calculatedHash, SHA256_DIGEST_LENGTH) == 0 &&
+           memcmp(current->prevHash, prevHash, SHA256_DIGEST_LENGTH) == 0;
+}
+
 /**
  * validateBlockchain - ensures that previous block's hash matches with new block's hash
  * @blockchain: pointer to blockchain to validate
@@ -135,20 +191,13 @@ Blockchain *initBlockchain(void)
  */
 int validateBlockchain(Blockchain *blockchain)
 {
-    if (!blockchain || !blockchain->head)
+    if (!blockchain || blockchain->length == 0)
         return 0;
-    unsigned char tmpHash[SHA256_DIGEST_LENGTH] = {0};
-    unsigned char calculatedHash[SHA256_DIGEST_LENGTH];
-    block_t *current = blockchain->head;
 
-    while (current)
+    for (int i = 0; i < blockchain->length; i++)
     {
-        calculateHash(current, current->nonce, calculatedHash);
-        if (memcmp(current->currHash, calculatedHash, SHA256_DIGEST_LENGTH) != 0 || memcmp(current->prevHash, tmpHash, SHA256_DIGEST_LENGTH) != 0) {
+        if (!validateBlock(blockchain, i))
             return 0;
-        }    
-        memcpy(tmpHash, current->currHash, SHA256_DIGEST_LENGTH);
-        current = current->next;
     }
     return 1;
 }
@@ -160,15 +209,15 @@ int validateBlockchain(Blockchain *blockchain)
  */
 void printBlockchain(Blockchain *blockchain)
 {
-    block_t *current = blockchain->head;
-    while (current) {
+    for (int b = 0; b < blockchain->length; b++) {
+        block_t *current = &blockchain->blocks[b];
         printf("Block %d\n", current->index);
         printf("Timestamp: %lu\n", current->timestamp);
-        transaction_t *trans = current->transactions->head;
-        while (trans)
+        for (int t = 0; t < current->transactions->nb_trans; t++)
         {
-            printf("  Transaction %d: %s -> %s, Amount: %s\n", trans->index, trans->sender, trans->receiver, trans->amount);
-            trans = trans->next;
+            transaction_t *trans = &current->transactions->trans[t];
+            transaction_payload_t *payload = &current->transactions->payloads[t];
+            printf("  Transaction %d: %s -> %s, Amount: %s, Fee: %" PRIu64 "\n", trans->index, payload->sender, payload->receiver, trans->amount, trans->fee);
         }
 
         printf("Previous Hash: ");
@@ -182,8 +231,6 @@ void printBlockchain(Blockchain *blockchain)
             printf("%02x", current->currHash[i]);
         }
         printf("\n\n");
-
-        current = current->next;
     }
 }
 
@@ -194,13 +241,9 @@ void printBlockchain(Blockchain *blockchain)
  */
 void freeBlockchain(Blockchain *blockchain)
 {
-    block_t *current = blockchain->head;
-    while (current) {
-        block_t *next = current->next;
-        freeTransactions(current->transactions);
-        free(current);
-        current = next;
-    }
+    for (int i = 0; i < blockchain->length; i++)
+        freeTransactions(blockchain->blocks[i].transactions);
+    free(blockchain->blocks);
     free(blockchain);
 }
 
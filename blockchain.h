@@ -2,9 +2,11 @@
 #define BLOCKCHAIN_H
 
 #include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <time.h>
 #include <openssl/sha.h>
 #include <openssl/evp.h>
@@ -12,64 +14,328 @@
 #define DATASIZE_MAX 1024
 #define BLOCKCHAIN_DATABASE "blockchain.dat"
 #define TRANSACTION_DATABASE "transaction.dat"
+#define TRANSACTION_LOCK "transaction.lock"
+#define TRANSACTION_QUEUE "/blockchain_queue"  /* shared memory name prefix */
+#define QUEUE_SLOTS 1024  /* Ring capacity, must be a power of two */
+#define QUEUE_STALL_SECONDS 10  /* A claimed slot unpublished this long is retired */
+#define POOL_MAX_ENTRIES 100000  /* Default pool entry cap, see blockchain_ctx_t */
+#define POOL_MAX_BYTES (256UL << 20)  /* Default pool memory cap */
+#define MAX_BLOCK_TRANSACTIONS 1000  /* Default transactions taken per block */
+#define MINING_CHECKPOINT "mining.ckpt"
+#define MINING_SOCKET "mining.sock"
+#define WORK_RANGE (1ULL << 24)  /* Nonces handed to a worker per request, divides 2^64 */
+#define MAX_WORKERS 64
+#define EXPORT_DIRECTORY "export"
+#define EXPORT_CHUNK_ROWS 65536  /* Rows summarized by each column stats entry */
+#define EXPORT_PATH_MAX 4096
+#define LATENCY_DATABASE "latency.dat"
+#define DATABASE_VERSION 5
+#define BLOCKCHAIN_MAGIC 0x4E484342  /* "BCHN" */
+#define TRANSACTION_MAGIC 0x4C505854  /* "TXPL" */
+#define LATENCY_MAGIC 0x5943544C  /* "LTCY" */
+#define RECORD_MAX (1U << 30)  /* Largest record payload accepted at load */
+#define SNAPSHOT_PATH_MAX 4096
+#define CONTEXT_PATH_MAX 4096
 #define INITIAL_DIFFICULTY 1  /* Starting difficulty level */
+#define CHECKPOINT_INTERVAL (1ULL << 22)  /* Hash attempts between mining checkpoints */
+#define MINING_PERIOD_MS 100  /* Duty cycle period of budgeted mining threads */
+#define MINING_CHUNK 4096  /* Nonces a mining thread claims at a time */
+#define MINING_MAX_THREADS 256
+#define LATENCY_SUB_BITS 7  /* 2^7 sub-buckets per power of two: values kept within 1/64 */
+#define LATENCY_BUCKETS ((1 << LATENCY_SUB_BITS) + (64 - LATENCY_SUB_BITS) * (1 << (LATENCY_SUB_BITS - 1)))
 
+/*
+ * Functions of the public API, the only ones libblockchain.so exports; the
+ * rest are internal and only reachable from the static library
+ */
+#define BC_API __attribute__((visibility("default")))
+
+/* Error codes reported by blockchainError() after a failed call */
+#define BC_OK 0
+#define BC_ENOMEM 1     /* allocation failed */
+#define BC_EIO 2        /* file, lock or socket operation failed, see errno */
+#define BC_ECORRUPT 3   /* bad file header or record */
+#define BC_ECRYPTO 4    /* hashing failed */
+#define BC_EINVAL 5     /* invalid argument */
+#define BC_EREJECTED 6  /* transaction turned away by a full pool */
+
+/*
+ * Where a blockchain lives: its database files, pool lock, mining
+ * checkpoint and socket, and the mapped submission queue, plus the limits
+ * of its pool and blocks. Set up once by initContext and only read
+ * afterwards, so threads may share a context; adjust the limits before
+ * sharing it.
+ */
+typedef struct blockchain_ctx_s {
+    char dir[CONTEXT_PATH_MAX];  /* directory holding the files below */
+    char chain_path[CONTEXT_PATH_MAX];
+    char pool_path[CONTEXT_PATH_MAX];
+    char lock_path[CONTEXT_PATH_MAX];
+    char checkpoint_path[CONTEXT_PATH_MAX];
+    char socket_path[CONTEXT_PATH_MAX];
+    char latency_path[CONTEXT_PATH_MAX];
+    char export_path[CONTEXT_PATH_MAX];  /* columnar export directory */
+    void *queue;  /* shared submission ring, NULL when unavailable */
+    FILE *log;    /* progress and warnings, NULL to stay silent */
+    int pool_max_entries;  /* pool entry cap, lowest fees are evicted beyond it */
+    size_t pool_max_bytes;  /* pool memory cap, lowers pool_max_entries */
+    int block_max_transactions;  /* highest fee transactions taken per block */
+    int salvage;  /* load the good part of a damaged file instead of failing */
+} blockchain_ctx_t;
+
+/* Hot, fixed-size part of a transaction, packed per block */
 typedef struct transaction_s {
+    uint64_t fee;  /* priority in the pool, higher is mined first */
     int index;
-    char sender[DATASIZE_MAX];
-    char receiver[DATASIZE_MAX];
     char amount[20];
-    struct transaction_s *next;
 } transaction_t;
 
+/* Large string payload of a transaction, kept apart from the hot fields */
+typedef struct transaction_payload_s {
+    char sender[DATASIZE_MAX];
+    char receiver[DATASIZE_MAX];
+    uint64_t admitted;  /* submission time in ns since the epoch, 0 if unknown; not hashed */
+} transaction_payload_t;
+
+/* Transaction i is trans[i] + payloads[i] */
 typedef struct list_of_transactions {
-    transaction_t *head;
-    transaction_t *tail;
+    transaction_t *trans;
+    transaction_payload_t *payloads;
     int nb_trans;
+    int capacity;
 } list_of_transactions;
 
+/* Bounded transaction pool indexed by priority, see pool.c */
+typedef struct tx_pool_s {
+    blockchain_ctx_t *ctx;  /* where the pool is saved */
+    list_of_transactions *entries;  /* unordered storage */
+    int *maxHeap;  /* entry positions, highest priority on top */
+    int *minHeap;  /* entry positions, lowest priority on top */
+    int *maxPos;   /* where each entry sits in maxHeap */
+    int *minPos;   /* where each entry sits in minHeap */
+    int capacity;
+    int max_entries;
+    int32_t next_index;  /* admission sequence of the next entry */
+} tx_pool_t;
+
+/* Compact block header, stored by value in Blockchain.blocks */
 typedef struct block_s {
     int index;
-    int nonce;
+    uint64_t nonce;
     uint64_t timestamp;
     list_of_transactions *transactions;
     unsigned char prevHash[SHA256_DIGEST_LENGTH];
     unsigned char currHash[SHA256_DIGEST_LENGTH];
-    struct block_s *next;
 } block_t;
 
+/* Status of a framed record read */
+#define RECORD_OK 0
+#define RECORD_END 1
+#define RECORD_TRUNCATED 2
+#define RECORD_CORRUPT 3
+#define RECORD_FORMAT 4  /* file header of another file type or format version */
+
+/* Leading header of every database file */
+typedef struct file_header_s {
+    uint32_t magic;
+    uint32_t version;
+    int32_t value;
+    uint32_t crc;  /* crc32c of the fields above */
+} file_header_t;
+
+/* Growable buffer holding one record payload */
+typedef struct record_s {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+} record_t;
+
+/* Database file being rewritten under a temporary name until committed */
+typedef struct snapshot_s {
+    FILE *file;
+    const char *path;
+    char tmp[SNAPSHOT_PATH_MAX];
+} snapshot_t;
+
+#define TRANSACTION_RECORD_SIZE (2 * sizeof(uint64_t) + sizeof(int) + 2 * DATASIZE_MAX + sizeof(((transaction_t *)0)->amount))
+#define BLOCK_RECORD_HEADER_SIZE (sizeof(int) + 2 * sizeof(uint64_t) + 2 * SHA256_DIGEST_LENGTH + sizeof(int))
+
+typedef struct mining_checkpoint_s {
+    int index;
+    uint64_t timestamp;
+    uint64_t nonce;  /* next nonce to try */
+    unsigned char prevHash[SHA256_DIGEST_LENGTH];
+    unsigned char txDigest[SHA256_DIGEST_LENGTH];
+} mining_checkpoint_t;
+
+/* CPU budget of a mining run */
+typedef struct mining_budget_s {
+    double cores;  /* CPU time to use at most, e.g. 0.25 or 2; 0 for one full core */
+    int idle;      /* 1 to mine under SCHED_IDLE so any other work runs first */
+} mining_budget_t;
+
+/* What a mining run used */
+typedef struct mining_stats_s {
+    uint64_t hashes;
+    double wall_seconds;
+    double cpu_seconds;  /* summed over threads */
+    int threads;
+} mining_stats_t;
+
+/* Latency stages traced from submission to the persisted block */
+#define LATENCY_QUEUE 0        /* submission to the start of mining, per transaction */
+#define LATENCY_MINING 1       /* nonce search */
+#define LATENCY_VALIDATION 2   /* checking the mined block */
+#define LATENCY_PERSISTENCE 3  /* writing and fsyncing the chain */
+#define LATENCY_TOTAL 4        /* submission to the fsynced block, per transaction */
+#define LATENCY_STAGES 5
+
+/* When a block went through each stage, in ns since the epoch */
+typedef struct block_trace_s {
+    int index;
+    uint64_t started;    /* mining started */
+    uint64_t found;      /* nonce found */
+    uint64_t validated;  /* block checked */
+    uint64_t writing;    /* chain write started */
+    uint64_t persisted;  /* chain fsynced */
+} block_trace_t;
+
+/*
+ * HDR-style histogram: values below 2^LATENCY_SUB_BITS get a bucket each,
+ * larger ones share 2^(LATENCY_SUB_BITS - 1) buckets per power of two, so
+ * any nanosecond latency is counted within 1/64 in fixed memory.
+ */
+typedef struct latency_histogram_s {
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+    uint64_t buckets[LATENCY_BUCKETS];
+} latency_histogram_t;
+
+/* Latency histograms kept next to a chain in LATENCY_DATABASE */
+typedef struct latency_s {
+    block_trace_t last;  /* most recent block traced */
+    latency_histogram_t stages[LATENCY_STAGES];
+} latency_t;
+
+typedef struct export_chunk_stats_s {
+    uint64_t rows;
+    uint64_t minTimestamp;
+    uint64_t maxTimestamp;
+    int32_t minHeight;
+    int32_t maxHeight;
+    uint32_t minSender;  /* dictionary ids, 0 when not dictionary encoded */
+    uint32_t maxSender;
+    uint32_t minReceiver;
+    uint32_t maxReceiver;
+    double minAmount;
+    double maxAmount;
+} export_chunk_stats_t;
+
+/* Block at height i is blocks[i] */
 typedef struct Blockchain {
-    block_t *head;
-    block_t *tail;
+    block_t *blocks;
     int length;
+    int capacity;
     int difficulty;
 } Blockchain;
 
 
+/* CONTEXT FUNCTIONS */
+BC_API int initContext(blockchain_ctx_t *ctx, const char *dir);
+BC_API void closeContext(blockchain_ctx_t *ctx);
+BC_API void logContext(blockchain_ctx_t *ctx, const char *format, ...) __attribute__((format(printf, 2, 3)));
+BC_API int blockchainError(void);
+BC_API const char *blockchainStrerror(int code);
+int blockchainFail(int code);
+
 /* TRANSACTION FUNCTIONS */
-int serializeUnspent(list_of_transactions *unspent);
-list_of_transactions *deserializeUnspent(void);
-int addTransactionToUnspent(const char *sender, const char *receiver, const char *amount);
-void freeTransactions(list_of_transactions *transactions);
+BC_API list_of_transactions *newTransactions(int capacity);
+BC_API int reserveTransactions(list_of_transactions *transactions, int capacity);
+BC_API int appendTransaction(list_of_transactions *transactions, const char *sender, const char *receiver, const char *amount, uint64_t fee);
+BC_API int serializeUnspent(blockchain_ctx_t *ctx, list_of_transactions *unspent, int32_t next_index);
+BC_API list_of_transactions *deserializeUnspent(blockchain_ctx_t *ctx, int32_t *next_index);
+BC_API int addTransactionToUnspent(blockchain_ctx_t *ctx, const char *sender, const char *receiver, const char *amount, uint64_t fee);
+BC_API int removeFromUnspent(blockchain_ctx_t *ctx, int *indices, int count);
+BC_API void freeTransactions(list_of_transactions *transactions);
+
+/* TRANSACTION POOL FUNCTIONS */
+BC_API int poolCapacity(const blockchain_ctx_t *ctx);
+BC_API tx_pool_t *loadPool(blockchain_ctx_t *ctx);
+BC_API int savePool(tx_pool_t *pool);
+BC_API void freePool(tx_pool_t *pool);
+BC_API int poolAdmit(tx_pool_t *pool, const char *sender, const char *receiver, const char *amount, uint64_t fee, uint64_t admitted);
+BC_API list_of_transactions *poolTakeTop(tx_pool_t *pool, int k);
+BC_API int poolRemoveIndices(tx_pool_t *pool, int *indices, int count);
+
+/* TRANSACTION QUEUE FUNCTIONS */
+void *openTransactionQueue(const blockchain_ctx_t *ctx);
+void closeTransactionQueue(void *queue);
+BC_API int removeTransactionQueue(const blockchain_ctx_t *ctx);
+int enqueueTransaction(blockchain_ctx_t *ctx, const char *sender, const char *receiver, const char *amount, uint64_t fee, uint64_t *position);
+int queueOutcome(blockchain_ctx_t *ctx, uint64_t position);
+BC_API int drainTransactionQueue(blockchain_ctx_t *ctx);
+BC_API int flushTransactionQueue(blockchain_ctx_t *ctx);
+BC_API int lockUnspent(blockchain_ctx_t *ctx, int wait);
+BC_API void unlockUnspent(blockchain_ctx_t *ctx, int fd);
+
+/* RECORD FUNCTIONS */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+int writeFileHeader(FILE *file, uint32_t magic, int32_t value);
+int readFileHeader(FILE *file, uint32_t magic, int32_t *value);
+int writeRecord(FILE *file, const record_t *record);
+int readRecord(FILE *file, record_t *record);
+const char *recordError(int status);
+int reserveRecord(record_t *record, size_t len);
+void freeRecord(record_t *record);
+FILE *beginSnapshot(snapshot_t *snapshot, const char *path);
+int commitSnapshot(snapshot_t *snapshot, int ok);
+int encodeTransaction(record_t *record, list_of_transactions *transactions, int i);
+int decodeTransaction(const unsigned char *data, list_of_transactions *transactions);
+int encodeBlock(record_t *record, block_t *block);
+int decodeBlock(const record_t *record, block_t *block);
 
 /* BLOCK MINING FUNCTIONS */
-void mine_block(block_t *block, int difficulty);
-void calculateHash(block_t *block, unsigned int nonce, unsigned char *hash);
+int mine_block(blockchain_ctx_t *ctx, block_t *block, int difficulty);
+BC_API int mineBlockWithBudget(blockchain_ctx_t *ctx, block_t *block, int difficulty, const mining_budget_t *budget, mining_stats_t *stats);
+BC_API int calculateHash(block_t *block, uint64_t nonce, unsigned char *hash);
 int is_valid_hash(unsigned char *hash, int difficulty);
 void hash_to_hex(unsigned char *hash, char *output);
 
+/* WORK DISTRIBUTION FUNCTIONS */
+BC_API int coordinateMining(blockchain_ctx_t *ctx, block_t *block, int difficulty);
+BC_API int workMining(blockchain_ctx_t *ctx, int once);
+
 /* BLOCKCHAIN FUNCTIONS */
-Blockchain *deserializeBlockchain(void);
-int serializeBlockchain(Blockchain *blockchain);
-Blockchain *initBlockchain(void);
-int validateBlockchain(Blockchain *blockchain);
-void printBlockchain(Blockchain *blockchain);
-void freeBlockchain(Blockchain *blockchain);
-list_of_transactions *createTransactions(const char *sender, const char *receiver, const char *amount);
-int adjustDifficulty(uint64_t prevTime, uint64_t currentTime, int currentDifficulty);
+BC_API Blockchain *deserializeBlockchain(blockchain_ctx_t *ctx);
+BC_API int serializeBlockchain(blockchain_ctx_t *ctx, Blockchain *blockchain);
+BC_API Blockchain *initBlockchain(blockchain_ctx_t *ctx);
+BC_API Blockchain *newBlockchain(int difficulty);
+BC_API int reserveBlocks(Blockchain *blockchain, int capacity);
+BC_API block_t *getBlock(Blockchain *blockchain, int height);
+BC_API int validateBlockchain(Blockchain *blockchain);
+BC_API int validateBlock(Blockchain *blockchain, int height);
+BC_API void printBlockchain(Blockchain *blockchain);
+BC_API void freeBlockchain(Blockchain *blockchain);
+BC_API list_of_transactions *createTransactions(const char *sender, const char *receiver, const char *amount);
+BC_API int adjustDifficulty(uint64_t prevTime, uint64_t currentTime, int currentDifficulty);
+
+/* LATENCY FUNCTIONS */
+BC_API uint64_t latencyNow(void);
+BC_API void recordLatency(latency_histogram_t *histogram, uint64_t ns);
+BC_API uint64_t latencyPercentile(const latency_histogram_t *histogram, double percentile);
+BC_API const char *latencyStageName(int stage);
+BC_API latency_t *loadLatency(blockchain_ctx_t *ctx);
+BC_API int saveLatency(blockchain_ctx_t *ctx, const latency_t *latency);
+BC_API int traceBlock(blockchain_ctx_t *ctx, const block_trace_t *trace, const uint64_t *admitted, int count);
+
+/* EXPORT FUNCTIONS */
+BC_API long exportTransactions(Blockchain *blockchain, const char *dir, int dictEncode);
 
 /* BLOCK FUNCTIONS */
-block_t *createBlock(int index, list_of_transactions *transactions, const unsigned char *prevHash, int difficulty);
-void addBlock(Blockchain *blockchain, block_t *block);
+BC_API block_t *prepareBlock(int index, list_of_transactions *transactions, const unsigned char *prevHash);
+BC_API block_t *createBlock(blockchain_ctx_t *ctx, int index, list_of_transactions *transactions, const unsigned char *prevHash, int difficulty);
+BC_API int addBlock(Blockchain *blockchain, block_t *block);
 
 #endif /* blockchain.h */
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "blockchain.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+
+/* Like errno: each thread sees the error of its own last failed call */
+static _Thread_local int lastError;
+
+/**
+ * blockchainFail - records the error of a failing call
+ * @code: BC_* error code
+ * Return: 0, so callers can return blockchainFail(code)
+ */
+int blockchainFail(int code)
+{
+    lastError = code;
+    return 0;
+}
+
+/**
+ * blockchainError - tells why the calling thread's last call failed
+ * Return: BC_* error code
+ */
+int blockchainError(void)
+{
+    return lastError;
+}
+
+/**
+ * blockchainStrerror - describes an error code
+ * @code: BC_* error code
+ * Return: static string
+ */
+const char *blockchainStrerror(int code)
+{
+    switch (code)
+    {
+    case BC_OK: return "success";
+    case BC_ENOMEM: return "out of memory";
+    case BC_EIO: return "input/output error";
+    case BC_ECORRUPT: return "corrupt database file";
+    case BC_ECRYPTO: return "hashing failed";
+    case BC_EINVAL: return "invalid argument";
+    case BC_EREJECTED: return "pool is full of higher fee transactions";
+    default: return "unknown error";
+    }
+}
+
+/**
+ * contextPath - joins a directory and a file name
+ * @out: buffer of CONTEXT_PATH_MAX bytes
+ * @dir: directory
+ * @name: file name
+ * Return: 1 on success else 0 if the path is too long
+ */
+static int contextPath(char *out, const char *dir, const char *name)
+{
+    return (size_t)snprintf(out, CONTEXT_PATH_MAX, "%s/%s", dir, name) < CONTEXT_PATH_MAX;
+}
+
+/**
+ * contextLimit - reads a limit from the environment
+ * @name: environment variable
+ * @max: largest accepted value
+ * @value: pointer to the limit, left at its default when the variable is unset
+ * Return: 1 on success else 0 if the variable is not a number in [1, max]
+ */
+static int contextLimit(const char *name, unsigned long long max, unsigned long long *value)
+{
+    const char *env = getenv(name);
+    unsigned long long parsed;
+    char *end;
+
+    if (!env)
+        return 1;
+    errno = 0;
+    parsed = strtoull(env, &end, 10);
+    if (end == env || *end != '\0' || errno || env[0] == '-' || parsed < 1 || parsed > max)
+        return 0;
+    *value = parsed;
+    return 1;
+}
+
+/**
+ * initContext - sets up a context for the blockchain stored in a directory
+ * @ctx: pointer to context to fill
+ * @dir: directory holding the database files, NULL for the current one
+ *
+ * The context starts silent; point ctx->log at a stream to get progress
+ * messages and warnings. The pool and block limits start at their
+ * defaults, or at BLOCKCHAIN_POOL_MAX_ENTRIES, BLOCKCHAIN_POOL_MAX_BYTES and
+ * BLOCKCHAIN_MAX_BLOCK_TRANSACTIONS when those are set, so every tool
+ * sharing a pool can be given the same limits.
+ * Return: 1 on success else 0
+ */
+int initContext(blockchain_ctx_t *ctx, const char *dir)
+{
+    if (!ctx)
+        return blockchainFail(BC_EINVAL);
+    memset(ctx, 0, sizeof(*ctx));
+    if (!dir)
+        dir = ".";
+    if ((size_t)snprintf(ctx->dir, sizeof(ctx->dir), "%s", dir) >= sizeof(ctx->dir) ||
+        !contextPath(ctx->chain_path, dir, BLOCKCHAIN_DATABASE) ||
+        !contextPath(ctx->pool_path, dir, TRANSACTION_DATABASE) ||
+        !contextPath(ctx->lock_path, dir, TRANSACTION_LOCK) ||
+        !contextPath(ctx->checkpoint_path, dir, MINING_CHECKPOINT) ||
+        !contextPath(ctx->socket_path, dir, MINING_SOCKET) ||
+        !contextPath(ctx->latency_path, dir, LATENCY_DATABASE) ||
+        !contextPath(ctx->export_path, dir, EXPORT_DIRECTORY))
+        return blockchainFail(BC_EINVAL);
+
+    unsigned long long entries = POOL_MAX_ENTRIES, bytes = POOL_MAX_BYTES, block = MAX_BLOCK_TRANSACTIONS;
+    if (!contextLimit("BLOCKCHAIN_POOL_MAX_ENTRIES", INT_MAX, &entries) ||
+        !contextLimit("BLOCKCHAIN_POOL_MAX_BYTES", SIZE_MAX, &bytes) ||
+        !contextLimit("BLOCKCHAIN_MAX_BLOCK_TRANSACTIONS", INT_MAX, &block))
+        return blockchainFail(BC_EINVAL);
+    ctx->pool_max_entries = (int)entries;
+    ctx->pool_max_bytes = (size_t)bytes;
+    ctx->block_max_transactions = (int)block;
+
+    /* Submissions fall back to the pool lock when there is no queue */
+    ctx->queue = openTransactionQueue(ctx);
+    return 1;
+}
+
+/**
+ * closeContext - releases what a context holds
+ * @ctx: pointer to context
+ */
+void closeContext(blockchain_ctx_t *ctx)
+{
+    if (!ctx)
+        return;
+    closeTransactionQueue(ctx->queue);
+    ctx->queue = NULL;
+}
+
+/**
+ * logContext - writes a line to the context log, if it has one
+ * @ctx: pointer to context
+ * @format: printf format
+ */
+void logContext(blockchain_ctx_t *ctx, const char *format, ...)
+{
+    va_list args;
+
+    if (!ctx || !ctx->log)
+        return;
+    va_start(args, format);
+    vfprintf(ctx->log, format, args);
+    va_end(args);
+    fflush(ctx->log);
+}
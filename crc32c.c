@@ -0,0 +1,96 @@
+#include "blockchain.h"
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_HW 1
+#endif
+
+#define CRC32C_POLY 0x82F63B78  /* Castagnoli, reflected */
+
+static uint32_t crc32c_table[256];
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+/**
+ * crc32c_init - fills the lookup table, once per process
+ */
+static void crc32c_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = c & 1 ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+        crc32c_table[i] = c;
+    }
+}
+
+/**
+ * crc32c_sw - portable table-driven CRC32C
+ * @crc: running checksum
+ * @buf: data
+ * @len: length of data
+ * Return: updated checksum
+ */
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    pthread_once(&crc32c_once, crc32c_init);
+    while (len--)
+        crc = crc32c_table[(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#ifdef CRC32C_HW
+/**
+ * crc32c_hw - CRC32C using the SSE4.2 crc32 instruction, 8 bytes at a time
+ * @crc: running checksum
+ * @buf: data
+ * @len: length of data
+ * Return: updated checksum
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char *buf, size_t len)
+{
+#ifdef __x86_64__
+    uint64_t c = crc;
+    while (len >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, buf, sizeof(word));
+        c = _mm_crc32_u64(c, word);
+        buf += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)c;
+#endif
+    while (len >= 4)
+    {
+        uint32_t word;
+        memcpy(&word, buf, sizeof(word));
+        crc = _mm_crc32_u32(crc, word);
+        buf += 4;
+        len -= 4;
+    }
+    while (len--)
+        crc = _mm_crc32_u8(crc, *buf++);
+    return crc;
+}
+#endif
+
+/**
+ * crc32c - computes the CRC32C (Castagnoli) checksum of a buffer, using
+ * SSE4.2 when the CPU has it
+ * @crc: checksum of preceding data, 0 to start
+ * @buf: data
+ * @len: length of data
+ * Return: checksum
+ */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
+{
+    crc = ~crc;
+#ifdef CRC32C_HW
+    if (__builtin_cpu_supports("sse4.2"))
+        return ~crc32c_hw(crc, buf, len);
+#endif
+    return ~crc32c_sw(crc, buf, len);
+}
@@ -7,19 +7,44 @@
  */
 int main()
 {
-    Blockchain *blockchain = initBlockchain();
+    blockchain_ctx_t ctx;
+
+    if (!initContext(&ctx, NULL))
+    {
+        fprintf(stderr, "Could not set up blockchain context: %s\n", blockchainStrerror(blockchainError()));
+        exit(EXIT_FAILURE);
+    }
+    ctx.log = stdout;
+
+    Blockchain *blockchain = initBlockchain(&ctx);
     if (!blockchain)
     {
-        fprintf(stderr, "Could not initialize blockchain\n");
+        fprintf(stderr, "Could not initialize blockchain: %s\n", blockchainStrerror(blockchainError()));
         exit(EXIT_FAILURE);
     }
-    if (!serializeBlockchain(blockchain))
+    if (!serializeBlockchain(&ctx, blockchain))
     {
-        fprintf(stderr, "Could not serialize created blockchain\n");
+        fprintf(stderr, "Could not serialize created blockchain: %s\n", blockchainStrerror(blockchainError()));
         fflush(stdout);
         freeBlockchain(blockchain);
         exit(EXIT_FAILURE);
     }
+    freeBlockchain(blockchain);
+
+    /* A new chain starts with an empty pool, including anything still queued */
+    int fd = lockUnspent(&ctx, 1);
+    list_of_transactions *unspent = newTransactions(0);
+    if (fd < 0 || !unspent || !drainTransactionQueue(&ctx) || !serializeUnspent(&ctx, unspent, 0) ||
+        !removeTransactionQueue(&ctx))
+    {
+        fprintf(stderr, "Could not reset unspent transactions: %s\n", blockchainStrerror(blockchainError()));
+        freeTransactions(unspent);
+        unlockUnspent(&ctx, fd);
+        exit(EXIT_FAILURE);
+    }
+    freeTransactions(unspent);
+    unlockUnspent(&ctx, fd);
+    closeContext(&ctx);
 
     printf("Blockchain created!\n");
     fflush(stdout);
@@ -1,122 +1,83 @@
 #include "blockchain.h"
+#include <errno.h>
 
 /**
  * deserializeBlockchain - deserializes blockchain from a file
- * Return: pointer to blockchain or NULL on failure
+ *
+ * Every record is checked against its CRC32C. A truncated or corrupt
+ * record is reported with its offset and fails the load with BC_ECORRUPT,
+ * so the damaged file is never written back shortened; with ctx->salvage
+ * set, the chain up to the last good block is returned instead. Hashes
+ * are not recomputed; use validateBlockchain for a full audit.
+ * @ctx: pointer to context
+ * Return: pointer to blockchain, empty if there is no chain file yet, or
+ * NULL on failure
  */
-Blockchain *deserializeBlockchain(void)
+Blockchain *deserializeBlockchain(blockchain_ctx_t *ctx)
 {
-    FILE *file = fopen(BLOCKCHAIN_DATABASE, "rb");
+    record_t record = {0};
+    int32_t difficulty;
+    int status;
+
+    FILE *file = fopen(ctx->chain_path, "rb");
     if (!file)
     {
-        perror("Failed to open blockchain file, initializing a new blockchain...");
-        return initBlockchain();
+        if (errno == ENOENT)
+            return newBlockchain(INITIAL_DIFFICULTY);
+        blockchainFail(BC_EIO);
+        return NULL;
     }
 
-    Blockchain *blockchain = (Blockchain *)malloc(sizeof(Blockchain));
-    if (!blockchain)
+    status = readFileHeader(file, BLOCKCHAIN_MAGIC, &difficulty);
+    if (status != RECORD_OK)
     {
-        perror("Failed to allocate memory for blockchain");
+        logContext(ctx, "%s: %s in file header\n", ctx->chain_path,
+                   status == RECORD_END ? "missing header" : recordError(status));
         fclose(file);
+        blockchainFail(BC_ECORRUPT);
         return NULL;
     }
 
-    blockchain->head = blockchain->tail = NULL;
-    blockchain->length = 0;
-
-    if (fread(&blockchain->difficulty, sizeof(blockchain->difficulty), 1, file) != 1)
+    Blockchain *blockchain = newBlockchain(difficulty);
+    if (!blockchain)
     {
-        perror("Failed to read blockchain difficulty");
-        free(blockchain);
         fclose(file);
         return NULL;
     }
 
-    block_t *prevBlock = NULL;
     while (1)
     {
-        block_t *block = (block_t *)malloc(sizeof(block_t));
-        if (!block)
-        {
-            perror("Failed to allocate memory for block");
-            break;
-        }
+        block_t block;
+        long offset = ftell(file);
 
-        if (fread(&block->index, sizeof(block->index), 1, file) != 1)
-        {
-            free(block);
+        status = readRecord(file, &record);
+        if (status == RECORD_END)
             break;
-        }
-
-        fread(&block->timestamp, sizeof(block->timestamp), 1, file);
-        fread(&block->nonce, sizeof(block->nonce), 1, file);
-        fread(block->prevHash, SHA256_DIGEST_LENGTH, 1, file);
-        fread(block->currHash, SHA256_DIGEST_LENGTH, 1, file);
-
-        list_of_transactions *transactions = (list_of_transactions *)malloc(sizeof(list_of_transactions));
-        if (!transactions)
+        if (status == RECORD_OK && !decodeBlock(&record, &block))
+            status = RECORD_CORRUPT;
+        if (status != RECORD_OK)
         {
-            perror("Failed to allocate memory for transactions");
-            free(block);
+            logContext(ctx, "%s: %s at offset %ld, after %d good blocks\n",
+                       ctx->chain_path, recordError(status), offset, blockchain->length);
+            if (ctx->salvage)
+                break;
+            freeBlockchain(blockchain);
+            blockchain = NULL;
+            blockchainFail(BC_ECORRUPT);
             break;
         }
 
-        if (fread(&transactions->nb_trans, sizeof(transactions->nb_trans), 1, file) != 1)
+        if (!reserveBlocks(blockchain, blockchain->length + 1))
         {
-            free(transactions);
-            free(block);
+            freeTransactions(block.transactions);
+            freeBlockchain(blockchain);
+            blockchain = NULL;
             break;
         }
-
-        transactions->head = transactions->tail = NULL;
-
-        for (int i = 0; i < transactions->nb_trans; i++)
-        {
-            transaction_t *trans = (transaction_t *)malloc(sizeof(transaction_t));
-            if (!trans)
-            {
-                perror("Failed to allocate memory for transaction");
-                break;
-            }
-
-            if (fread(&trans->index, sizeof(trans->index), 1, file) != 1 ||
-                fread(trans->sender, sizeof(trans->sender), 1, file) != 1 ||
-                fread(trans->receiver, sizeof(trans->receiver), 1, file) != 1 ||
-                fread(trans->amount, sizeof(trans->amount), 1, file) != 1)  // Fixed by adding '&'
-            {
-                free(trans);
-                break;
-            }
-
-            trans->next = NULL;
-            if (transactions->head == NULL)
-            {
-                transactions->head = transactions->tail = trans;
-            }
-            else
-            {
-                transactions->tail->next = trans;
-                transactions->tail = trans;
-            }
-        }
-
-        block->transactions = transactions;
-        block->next = NULL;
-
-        if (blockchain->head == NULL)
-        {
-            blockchain->head = blockchain->tail = block;
-        }
-        else
-        {
-            prevBlock->next = block;
-            blockchain->tail = block;
-        }
-
-        prevBlock = block;
-        blockchain->length++;
+        blockchain->blocks[blockchain->length++] = block;
     }
 
+    freeRecord(&record);
     fclose(file);
     return blockchain;
-}
\ No newline at end of file
+}
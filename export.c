@@ -0,0 +1,638 @@
+#include "blockchain.h"
+#include <errno.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define EXPORT_MAGIC 0x4C4F4358  /* "XCOL" */
+#define EXPORT_VERSION 2
+#define EXPORT_FLAG_DICT 1
+
+/* Column files, all raw native arrays so they can be mmapped directly */
+static const char *const column_names[] = {
+    "height.col", "timestamp.col", "sender.col", "receiver.col", "amount.col"
+};
+enum { COL_HEIGHT, COL_TIMESTAMP, COL_SENDER, COL_RECEIVER, COL_AMOUNT, COL_COUNT };
+
+typedef struct export_manifest_s {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t dict_entries;
+    uint64_t dict_bytes;  /* committed length of address.dict */
+    uint64_t rows;
+    int32_t next_height;
+    unsigned char tipHash[SHA256_DIGEST_LENGTH];
+} export_manifest_t;
+
+/* In-memory string dictionary (open addressing, FNV-1a) */
+typedef struct export_dict_s {
+    char **strings;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t *slots;  /* id + 1, 0 when empty */
+    uint32_t nb_slots;
+} export_dict_t;
+
+/* Open column state while appending */
+typedef struct exporter_s {
+    const char *dir;
+    int dictEncode;
+    FILE *columns[COL_COUNT];
+    FILE *senderStr, *receiverStr, *dictFile;
+    uint64_t senderOff, receiverOff;
+    export_manifest_t manifest;
+    export_dict_t dict;
+    export_chunk_stats_t *chunks;
+    uint64_t nb_chunks, cap_chunks;
+} exporter_t;
+
+/**
+ * exportPath - builds path of a file in the export directory
+ * @dir: export directory
+ * @name: file name
+ * @path: buffer of EXPORT_PATH_MAX bytes
+ * Return: path
+ */
+static char *exportPath(const char *dir, const char *name, char *path)
+{
+    snprintf(path, EXPORT_PATH_MAX, "%s/%s", dir, name);
+    return path;
+}
+
+static uint32_t hashString(const char *str)
+{
+    uint32_t h = 2166136261u;
+    while (*str)
+        h = (h ^ (unsigned char)*str++) * 16777619u;
+    return h;
+}
+
+/**
+ * dictGrow - doubles the slot table and rehashes
+ * @dict: pointer to dictionary
+ * Return: 1 on success else 0
+ */
+static int dictGrow(export_dict_t *dict)
+{
+    uint32_t nb = dict->nb_slots ? dict->nb_slots * 2 : 1024;
+    uint32_t *slots = calloc(nb, sizeof(*slots));
+    if (!slots)
+        return 0;
+    for (uint32_t id = 0; id < dict->count; id++)
+    {
+        uint32_t i = hashString(dict->strings[id]) & (nb - 1);
+        while (slots[i])
+            i = (i + 1) & (nb - 1);
+        slots[i] = id + 1;
+    }
+    free(dict->slots);
+    dict->slots = slots;
+    dict->nb_slots = nb;
+    return 1;
+}
+
+/**
+ * dictLookup - finds or inserts a string in the dictionary
+ * @dict: pointer to dictionary
+ * @str: string to encode
+ * @added: set to 1 if str was inserted
+ * Return: id of string, or UINT32_MAX on failure
+ */
+static uint32_t dictLookup(export_dict_t *dict, const char *str, int *added)
+{
+    uint32_t i;
+
+    *added = 0;
+    if ((uint64_t)(dict->count + 1) * 2 > dict->nb_slots && !dictGrow(dict))
+        return UINT32_MAX;
+    i = hashString(str) & (dict->nb_slots - 1);
+    while (dict->slots[i])
+    {
+        if (strcmp(dict->strings[dict->slots[i] - 1], str) == 0)
+            return dict->slots[i] - 1;
+        i = (i + 1) & (dict->nb_slots - 1);
+    }
+    if (dict->count == dict->capacity)
+    {
+        uint32_t cap = dict->capacity ? dict->capacity * 2 : 1024;
+        char **strings = realloc(dict->strings, cap * sizeof(*strings));
+        if (!strings)
+            return UINT32_MAX;
+        dict->strings = strings;
+        dict->capacity = cap;
+    }
+    dict->strings[dict->count] = strdup(str);
+    if (!dict->strings[dict->count])
+        return UINT32_MAX;
+    dict->slots[i] = ++dict->count;
+    *added = 1;
+    return dict->count - 1;
+}
+
+static void dictFree(export_dict_t *dict)
+{
+    for (uint32_t id = 0; id < dict->count; id++)
+        free(dict->strings[id]);
+    free(dict->strings);
+    free(dict->slots);
+    memset(dict, 0, sizeof(*dict));
+}
+
+/**
+ * loadDict - reads the dictionary written by earlier exports
+ * @exp: pointer to exporter
+ * @file: dictionary file, entries are a uint32 length then the bytes
+ * Return: 1 on success else 0
+ */
+static int loadDict(exporter_t *exp, FILE *file)
+{
+    char buf[DATASIZE_MAX];
+    uint32_t len;
+    int added;
+
+    for (uint32_t id = 0; id < exp->manifest.dict_entries; id++)
+    {
+        if (fread(&len, sizeof(len), 1, file) != 1 || len >= sizeof(buf) ||
+            fread(buf, 1, len, file) != len)
+            return 0;
+        buf[len] = '\0';
+        if (dictLookup(&exp->dict, buf, &added) != id)
+            return 0;
+    }
+    return (uint64_t)ftello(file) == exp->manifest.dict_bytes;
+}
+
+/**
+ * resetExport - discards every export file so the chain is exported again
+ * @exp: pointer to exporter
+ */
+static void resetExport(exporter_t *exp)
+{
+    char path[EXPORT_PATH_MAX];
+
+    for (int c = 0; c < COL_COUNT; c++)
+        remove(exportPath(exp->dir, column_names[c], path));
+    remove(exportPath(exp->dir, "sender.str", path));
+    remove(exportPath(exp->dir, "receiver.str", path));
+    remove(exportPath(exp->dir, "address.dict", path));
+    remove(exportPath(exp->dir, "stats.col", path));
+    dictFree(&exp->dict);
+    exp->nb_chunks = 0;
+    memset(&exp->manifest, 0, sizeof(exp->manifest));
+    exp->manifest.magic = EXPORT_MAGIC;
+    exp->manifest.version = EXPORT_VERSION;
+    exp->manifest.flags = exp->dictEncode ? EXPORT_FLAG_DICT : 0;
+}
+
+/**
+ * openAppend - opens a column for appending, dropping any bytes past the
+ * committed length left behind by an interrupted export
+ * @exp: pointer to exporter
+ * @name: file name
+ * @committed: committed length in bytes
+ * Return: file or NULL on failure
+ */
+static FILE *openAppend(exporter_t *exp, const char *name, uint64_t committed)
+{
+    char path[EXPORT_PATH_MAX];
+    FILE *file;
+
+    exportPath(exp->dir, name, path);
+    file = fopen(path, "ab");
+    if (!file)
+        return NULL;
+    if (ftruncate(fileno(file), (off_t)committed) != 0)
+    {
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+/**
+ * fileLength - size of a file in the export directory
+ * @exp: pointer to exporter
+ * @name: file name
+ * Return: size in bytes, 0 if missing
+ */
+static uint64_t fileLength(exporter_t *exp, const char *name)
+{
+    char path[EXPORT_PATH_MAX];
+    struct stat st;
+
+    if (stat(exportPath(exp->dir, name, path), &st) != 0)
+        return 0;
+    return (uint64_t)st.st_size;
+}
+
+/**
+ * updateStats - folds a row into the stats of its chunk
+ * @exp: pointer to exporter
+ * @row: values of the row
+ * Return: 1 on success else 0
+ */
+static int updateStats(exporter_t *exp, const export_chunk_stats_t *row)
+{
+    export_chunk_stats_t *chunk;
+
+    if (exp->manifest.rows % EXPORT_CHUNK_ROWS == 0)
+    {
+        if (exp->nb_chunks == exp->cap_chunks)
+        {
+            uint64_t cap = exp->cap_chunks ? exp->cap_chunks * 2 : 64;
+            export_chunk_stats_t *chunks = realloc(exp->chunks, cap * sizeof(*chunks));
+            if (!chunks)
+                return 0;
+            exp->chunks = chunks;
+            exp->cap_chunks = cap;
+        }
+        chunk = &exp->chunks[exp->nb_chunks++];
+        *chunk = *row;
+        chunk->rows = 0;
+        chunk->minAmount = INFINITY;
+        chunk->maxAmount = -INFINITY;
+    }
+    chunk = &exp->chunks[exp->nb_chunks - 1];
+    chunk->rows++;
+#define FOLD(lo, hi, v) do { if ((v) < chunk->lo) chunk->lo = (v); if ((v) > chunk->hi) chunk->hi = (v); } while (0)
+    FOLD(minHeight, maxHeight, row->minHeight);
+    FOLD(minTimestamp, maxTimestamp, row->minTimestamp);
+    FOLD(minSender, maxSender, row->minSender);
+    FOLD(minReceiver, maxReceiver, row->minReceiver);
+    if (!isnan(row->minAmount))
+        FOLD(minAmount, maxAmount, row->minAmount);
+#undef FOLD
+    return 1;
+}
+
+/**
+ * columnWidth - size of one value of a column
+ * @exp: pointer to exporter
+ * @column: COL_* column
+ * Return: width in bytes
+ */
+static size_t columnWidth(exporter_t *exp, int column)
+{
+    static const size_t widths[COL_COUNT] = {
+        sizeof(int32_t), sizeof(uint64_t), 0, 0, sizeof(double)
+    };
+
+    return widths[column] ? widths[column] : (exp->dictEncode ? sizeof(uint32_t) : sizeof(uint64_t));
+}
+
+/**
+ * rebuildLastChunk - recomputes the stats of the last chunk from the
+ * committed rows of the columns
+ * @exp: pointer to exporter, nb_chunks holding the chunk to rebuild
+ * Return: 1 on success else 0
+ */
+static int rebuildLastChunk(exporter_t *exp)
+{
+    uint64_t rows = exp->manifest.rows, start = (exp->nb_chunks - 1) * EXPORT_CHUNK_ROWS;
+    char path[EXPORT_PATH_MAX];
+    FILE *cols[COL_COUNT];
+    int ok = 1;
+
+    for (int c = 0; c < COL_COUNT; c++)
+    {
+        cols[c] = fopen(exportPath(exp->dir, column_names[c], path), "rb");
+        if (!cols[c] || fseeko(cols[c], (off_t)(start * columnWidth(exp, c)), SEEK_SET) != 0)
+            ok = 0;
+    }
+    exp->nb_chunks--;
+    for (exp->manifest.rows = start; ok && exp->manifest.rows < rows; exp->manifest.rows++)
+    {
+        export_chunk_stats_t row = {0};
+        int32_t height;
+        uint64_t timestamp;
+        double amount;
+
+        ok = fread(&height, sizeof(height), 1, cols[COL_HEIGHT]) == 1 &&
+             fread(&timestamp, sizeof(timestamp), 1, cols[COL_TIMESTAMP]) == 1 &&
+             fread(&amount, sizeof(amount), 1, cols[COL_AMOUNT]) == 1;
+        /* Plain string offsets are not summarized, their ids stay 0 */
+        if (ok && exp->dictEncode)
+            ok = fread(&row.minSender, sizeof(row.minSender), 1, cols[COL_SENDER]) == 1 &&
+                 fread(&row.minReceiver, sizeof(row.minReceiver), 1, cols[COL_RECEIVER]) == 1;
+        row.minHeight = row.maxHeight = height;
+        row.minTimestamp = row.maxTimestamp = timestamp;
+        row.minAmount = row.maxAmount = amount;
+        row.maxSender = row.minSender;
+        row.maxReceiver = row.minReceiver;
+        ok = ok && updateStats(exp, &row);
+    }
+    for (int c = 0; c < COL_COUNT; c++)
+        if (cols[c])
+            fclose(cols[c]);
+    return ok && exp->manifest.rows == rows;
+}
+
+/**
+ * loadStats - reads the chunk stats of a previous export
+ * @exp: pointer to exporter, its manifest loaded and columns checked
+ *
+ * stats.col is published just before the manifest, so a run interrupted in
+ * between leaves stats counting rows that were rolled back. The last chunk
+ * is rebuilt from the columns whenever it does not hold exactly the
+ * committed rows.
+ * Return: 1 on success else 0
+ */
+static int loadStats(exporter_t *exp)
+{
+    uint64_t nb = (exp->manifest.rows + EXPORT_CHUNK_ROWS - 1) / EXPORT_CHUNK_ROWS, read = 0;
+    char path[EXPORT_PATH_MAX];
+    FILE *file;
+
+    if (nb == 0)
+        return 1;
+    exp->chunks = malloc(nb * sizeof(*exp->chunks));
+    if (!exp->chunks)
+        return 0;
+    exp->cap_chunks = nb;
+    file = fopen(exportPath(exp->dir, "stats.col", path), "rb");
+    if (file)
+    {
+        read = fread(exp->chunks, sizeof(*exp->chunks), nb, file);
+        fclose(file);
+    }
+    if (read + 1 < nb)
+        return 0;
+    exp->nb_chunks = nb;
+    if (read == nb && exp->chunks[nb - 1].rows == exp->manifest.rows - (nb - 1) * EXPORT_CHUNK_ROWS)
+        return 1;
+    return rebuildLastChunk(exp);
+}
+
+/**
+ * openExport - loads the manifest, dictionary and chunk stats of a
+ * previous export and opens every column for appending
+ * @exp: pointer to exporter
+ * @blockchain: chain being exported, used to detect a replaced chain
+ * Return: 1 on success else 0
+ */
+static int openExport(exporter_t *exp, Blockchain *blockchain)
+{
+    char path[EXPORT_PATH_MAX];
+    FILE *file;
+    int valid = 0;
+
+    if (mkdir(exp->dir, 0755) != 0 && errno != EEXIST)
+        return blockchainFail(BC_EIO);
+
+    file = fopen(exportPath(exp->dir, "manifest", path), "rb");
+    if (file)
+    {
+        valid = fread(&exp->manifest, sizeof(exp->manifest), 1, file) == 1;
+        if (valid && exp->dictEncode < 0)
+            exp->dictEncode = exp->manifest.flags & EXPORT_FLAG_DICT;
+        valid = valid && exp->manifest.magic == EXPORT_MAGIC &&
+                exp->manifest.version == EXPORT_VERSION &&
+                (exp->manifest.flags & EXPORT_FLAG_DICT) == (uint32_t)(exp->dictEncode ? EXPORT_FLAG_DICT : 0) &&
+                exp->manifest.next_height <= blockchain->length;
+        fclose(file);
+    }
+    if (exp->dictEncode < 0)
+        exp->dictEncode = 1;
+
+    /* The chain must still contain the last block we exported */
+    if (valid && exp->manifest.next_height > 0)
+    {
+        block_t *tip = getBlock(blockchain, exp->manifest.next_height - 1);
+        valid = tip && memcmp(tip->currHash, exp->manifest.tipHash, SHA256_DIGEST_LENGTH) == 0;
+    }
+
+    if (valid && exp->dictEncode)
+    {
+        file = fopen(exportPath(exp->dir, "address.dict", path), "rb");
+        valid = file && loadDict(exp, file);
+        if (file)
+            fclose(file);
+    }
+
+    for (int c = 0; valid && c < COL_COUNT; c++)
+        valid = fileLength(exp, column_names[c]) >= exp->manifest.rows * columnWidth(exp, c);
+    valid = valid && loadStats(exp);
+
+    if (!valid)
+        resetExport(exp);
+
+    for (int c = 0; c < COL_COUNT; c++)
+    {
+        exp->columns[c] = openAppend(exp, column_names[c], exp->manifest.rows * columnWidth(exp, c));
+        if (!exp->columns[c])
+            return 0;
+    }
+    if (exp->dictEncode)
+    {
+        exp->dictFile = openAppend(exp, "address.dict", exp->manifest.dict_bytes);
+        return exp->dictFile != NULL;
+    }
+
+    /* Plain strings: the offset columns hold the end offset of each row */
+    exp->senderOff = exp->receiverOff = 0;
+    if (exp->manifest.rows)
+    {
+        uint64_t off[2] = {0, 0};
+        FILE *cols[2] = {NULL, NULL};
+        cols[0] = fopen(exportPath(exp->dir, "sender.col", path), "rb");
+        cols[1] = fopen(exportPath(exp->dir, "receiver.col", path), "rb");
+        for (int i = 0; i < 2; i++)
+        {
+            if (!cols[i] || fseeko(cols[i], (off_t)((exp->manifest.rows - 1) * sizeof(uint64_t)), SEEK_SET) != 0 ||
+                fread(&off[i], sizeof(off[i]), 1, cols[i]) != 1)
+                valid = 0;
+            if (cols[i])
+                fclose(cols[i]);
+        }
+        if (!valid)
+            return 0;
+        exp->senderOff = off[0];
+        exp->receiverOff = off[1];
+    }
+    exp->senderStr = openAppend(exp, "sender.str", exp->senderOff);
+    exp->receiverStr = openAppend(exp, "receiver.str", exp->receiverOff);
+    return exp->senderStr && exp->receiverStr;
+}
+
+/**
+ * writeString - encodes a sender or receiver into its column
+ * @exp: pointer to exporter
+ * @str: string to encode
+ * @column: COL_SENDER or COL_RECEIVER
+ * @id: set to the dictionary id (0 when not dictionary encoded)
+ * Return: 1 on success else 0
+ */
+static int writeString(exporter_t *exp, const char *str, int column, uint32_t *id)
+{
+    int added;
+
+    *id = 0;
+    if (exp->dictEncode)
+    {
+        *id = dictLookup(&exp->dict, str, &added);
+        if (*id == UINT32_MAX)
+            return 0;
+        if (added)
+        {
+            uint32_t len = (uint32_t)strlen(str);
+            if (fwrite(&len, sizeof(len), 1, exp->dictFile) != 1 ||
+                fwrite(str, 1, len, exp->dictFile) != len)
+                return 0;
+            exp->manifest.dict_bytes += sizeof(len) + len;
+        }
+        return fwrite(id, sizeof(*id), 1, exp->columns[column]) == 1;
+    }
+
+    FILE *strFile = column == COL_SENDER ? exp->senderStr : exp->receiverStr;
+    uint64_t *off = column == COL_SENDER ? &exp->senderOff : &exp->receiverOff;
+    size_t len = strlen(str);
+    if (fwrite(str, 1, len, strFile) != len)
+        return 0;
+    *off += len;
+    return fwrite(off, sizeof(*off), 1, exp->columns[column]) == 1;
+}
+
+/**
+ * commitExport - flushes the columns to disk then publishes stats and
+ * manifest, which make the new rows visible
+ * @exp: pointer to exporter
+ *
+ * The appended files are fsynced before the manifest is published, so a
+ * manifest that survives a crash never covers rows that did not.
+ * Return: 1 on success else 0
+ */
+static int commitExport(exporter_t *exp)
+{
+    char statsPath[EXPORT_PATH_MAX], manifestPath[EXPORT_PATH_MAX];
+    FILE *files[COL_COUNT + 3];
+    snapshot_t snapshot;
+    FILE *file;
+    int ok = 1;
+
+    for (int c = 0; c < COL_COUNT; c++)
+        files[c] = exp->columns[c];
+    files[COL_COUNT] = exp->dictFile;
+    files[COL_COUNT + 1] = exp->senderStr;
+    files[COL_COUNT + 2] = exp->receiverStr;
+    for (int i = 0; i < COL_COUNT + 3; i++)
+    {
+        if (!files[i])
+            continue;
+        if (fflush(files[i]) != 0 || fsync(fileno(files[i])) != 0)
+            ok = 0;
+        if (fclose(files[i]) != 0)
+            ok = 0;
+    }
+    memset(exp->columns, 0, sizeof(exp->columns));
+    exp->dictFile = exp->senderStr = exp->receiverStr = NULL;
+    if (!ok)
+        return 0;
+
+    /* Stats are replaced whole; a run interrupted before the manifest is caught by loadStats */
+    file = beginSnapshot(&snapshot, exportPath(exp->dir, "stats.col", statsPath));
+    if (!file)
+        return 0;
+    ok = fwrite(exp->chunks, sizeof(*exp->chunks), exp->nb_chunks, file) == exp->nb_chunks;
+    if (!commitSnapshot(&snapshot, ok))
+        return 0;
+
+    exp->manifest.dict_entries = exp->dict.count;
+    file = beginSnapshot(&snapshot, exportPath(exp->dir, "manifest", manifestPath));
+    if (!file)
+        return 0;
+    ok = fwrite(&exp->manifest, sizeof(exp->manifest), 1, file) == 1;
+    return commitSnapshot(&snapshot, ok);
+}
+
+/**
+ * exportTransactions - appends the transactions of every block not yet
+ * exported to the column files in dir
+ * @blockchain: pointer to blockchain
+ * @dir: export directory, created if missing
+ * @dictEncode: 1 to dictionary encode addresses, 0 to store them plain,
+ * -1 to keep the encoding of the existing export
+ *
+ * Columns are raw native arrays, one value per transaction:
+ *   height.col (int32), timestamp.col (uint64), amount.col (double, NaN
+ *   when the amount is not numeric), sender.col and receiver.col (uint32
+ *   ids into address.dict, or uint64 end offsets into sender.str and
+ *   receiver.str when not dictionary encoded).
+ * stats.col holds an export_chunk_stats_t per EXPORT_CHUNK_ROWS rows.
+ * Rows are only visible once the manifest is rewritten, so an interrupted
+ * export is rolled back the next time. If the chain no longer contains the
+ * last exported block everything is exported again.
+ * Return: number of rows appended, or -1 on failure
+ */
+long exportTransactions(Blockchain *blockchain, const char *dir, int dictEncode)
+{
+    exporter_t exp;
+    long appended = 0;
+    int ok;
+
+    if (!blockchain || !dir)
+    {
+        blockchainFail(BC_EINVAL);
+        return -1;
+    }
+    blockchainFail(BC_OK);
+    memset(&exp, 0, sizeof(exp));
+    exp.dir = dir;
+    exp.dictEncode = dictEncode;
+
+    ok = openExport(&exp, blockchain);
+    for (int h = exp.manifest.next_height; ok && h < blockchain->length; h++)
+    {
+        block_t *block = &blockchain->blocks[h];
+        list_of_transactions *transactions = block->transactions;
+        int nb_trans = transactions ? transactions->nb_trans : 0;
+        int32_t height = block->index;
+
+        for (int t = 0; ok && t < nb_trans; t++)
+        {
+            export_chunk_stats_t row;
+            char *end;
+            const char *amountStr = transactions->trans[t].amount;
+            double amount = strtod(amountStr, &end);
+            if (end == amountStr)
+                amount = NAN;
+
+            row.minHeight = row.maxHeight = height;
+            row.minTimestamp = row.maxTimestamp = block->timestamp;
+            row.minAmount = row.maxAmount = amount;
+            ok = fwrite(&height, sizeof(height), 1, exp.columns[COL_HEIGHT]) == 1 &&
+                 fwrite(&block->timestamp, sizeof(block->timestamp), 1, exp.columns[COL_TIMESTAMP]) == 1 &&
+                 fwrite(&amount, sizeof(amount), 1, exp.columns[COL_AMOUNT]) == 1 &&
+                 writeString(&exp, transactions->payloads[t].sender, COL_SENDER, &row.minSender) &&
+                 writeString(&exp, transactions->payloads[t].receiver, COL_RECEIVER, &row.minReceiver);
+            row.maxSender = row.minSender;
+            row.maxReceiver = row.minReceiver;
+            ok = ok && updateStats(&exp, &row);
+            exp.manifest.rows++;
+            appended++;
+        }
+        exp.manifest.next_height = h + 1;
+        memcpy(exp.manifest.tipHash, block->currHash, SHA256_DIGEST_LENGTH);
+    }
+
+    ok = ok && commitExport(&exp);
+    if (!ok)
+    {
+        /* Column writes fail silently; anything not yet reported is I/O */
+        if (blockchainError() == BC_OK)
+            blockchainFail(BC_EIO);
+        /* Still drop any column still open on an early failure */
+        for (int c = 0; c < COL_COUNT; c++)
+            if (exp.columns[c])
+                fclose(exp.columns[c]);
+        if (exp.dictFile)
+            fclose(exp.dictFile);
+        if (exp.senderStr)
+            fclose(exp.senderStr);
+        if (exp.receiverStr)
+            fclose(exp.receiverStr);
+    }
+    dictFree(&exp.dict);
+    free(exp.chunks);
+    return ok ? appended : -1;
+}
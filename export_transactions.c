@@ -0,0 +1,54 @@
+#include "blockchain.h"
+
+/**
+ * main - exports blockchain transactions to column files
+ * @argc: argument count
+ * @argv: [-p] [directory]; -p stores addresses plain instead of
+ * dictionary encoded, directory defaults to EXPORT_DIRECTORY next to the
+ * chain
+ * Return: 0 on success
+ */
+int main(int argc, char **argv)
+{
+    const char *dir = NULL;
+    int dictEncode = 1;
+    long appended;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-p") == 0)
+            dictEncode = 0;
+        else
+            dir = argv[i];
+    }
+
+    blockchain_ctx_t ctx;
+
+    if (!initContext(&ctx, NULL))
+    {
+        fprintf(stderr, "Could not set up blockchain context: %s\n", blockchainStrerror(blockchainError()));
+        exit(EXIT_FAILURE);
+    }
+    ctx.log = stdout;
+    if (!dir)
+        dir = ctx.export_path;
+
+    Blockchain *blockchain = deserializeBlockchain(&ctx);
+    closeContext(&ctx);
+    if (!blockchain)
+    {
+        fprintf(stderr, "Could not get blockchain from file: %s\n", blockchainStrerror(blockchainError()));
+        exit(EXIT_FAILURE);
+    }
+
+    appended = exportTransactions(blockchain, dir, dictEncode);
+    freeBlockchain(blockchain);
+    if (appended < 0)
+    {
+        fprintf(stderr, "Could not export transactions to %s: %s\n", dir, blockchainStrerror(blockchainError()));
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Exported %ld new transactions to %s\n", appended, dir);
+    return 0;
+}
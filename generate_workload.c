@@ -0,0 +1,460 @@
+#include "blockchain.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+/*
+ * Writes a synthetic chain and pool straight to the database files, for
+ * load tests. Everything is derived from the seed: a block's transactions
+ * come from a generator seeded with (seed, height), timestamps advance a
+ * fixed step from GENERATOR_EPOCH and each block keeps the smallest nonce
+ * meeting the difficulty, so a seed always yields the same files whatever
+ * the thread count.
+ */
+
+#define GENERATOR_EPOCH 1700000000ULL
+#define GENERATOR_BLOCK_TIME 60
+#define ADDRESS_ALPHABET "abcdefghijklmnopqrstuvwxyz234567"
+
+typedef struct generator_s {
+    long blocks;
+    int per_block;
+    long pool;
+    long addresses;
+    double zipf;
+    int min_len, max_len;
+    int difficulty;
+    int threads;
+    uint64_t seed;
+    double *cdf;    /* cumulative Zipf weights of the sender ranks */
+    long *ids;      /* address id of each sender rank, a seeded shuffle */
+} generator_t;
+
+typedef struct search_s {
+    pthread_barrier_t start, done;
+    block_t *block;
+    int difficulty;
+    int threads;
+    int quit;
+    _Atomic int failed;
+    _Atomic uint64_t best;
+    _Atomic uint64_t hashes;
+} search_t;
+
+/**
+ * mix - splitmix64 step, the generator behind every random choice
+ * @state: pointer to generator state
+ * Return: next 64 random bits
+ */
+static uint64_t mix(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * uniform - draws a double in [0, 1)
+ * @state: pointer to generator state
+ * Return: random double
+ */
+static double uniform(uint64_t *state)
+{
+    return (mix(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * buildZipf - tabulates the Zipf CDF over the address ranks, and shuffles
+ * the ranks into address ids so the busiest senders are spread out
+ * @gen: pointer to generator settings
+ * Return: 1 on success else 0
+ */
+static int buildZipf(generator_t *gen)
+{
+    uint64_t state = gen->seed ^ 0x5A17F00DULL;
+    double sum = 0;
+
+    gen->cdf = malloc(gen->addresses * sizeof(*gen->cdf));
+    gen->ids = malloc(gen->addresses * sizeof(*gen->ids));
+    if (!gen->cdf || !gen->ids)
+        return 0;
+    /* Fisher-Yates: a permutation, so every id stays reachable */
+    for (long i = 0; i < gen->addresses; i++)
+        gen->ids[i] = i;
+    for (long i = gen->addresses - 1; i > 0; i--)
+    {
+        long j = (long)(mix(&state) % (uint64_t)(i + 1));
+        long id = gen->ids[i];
+        gen->ids[i] = gen->ids[j];
+        gen->ids[j] = id;
+    }
+    for (long i = 0; i < gen->addresses; i++)
+    {
+        sum += 1.0 / pow((double)(i + 1), gen->zipf);
+        gen->cdf[i] = sum;
+    }
+    for (long i = 0; i < gen->addresses; i++)
+        gen->cdf[i] /= sum;
+    return 1;
+}
+
+/**
+ * zipfRank - draws a sender rank, rank 0 being the most active
+ * @gen: pointer to generator settings
+ * @state: pointer to generator state
+ * Return: rank in [0, addresses)
+ */
+static long zipfRank(generator_t *gen, uint64_t *state)
+{
+    double u = uniform(state);
+    long lo = 0, hi = gen->addresses - 1;
+
+    while (lo < hi)
+    {
+        long mid = lo + (hi - lo) / 2;
+        if (gen->cdf[mid] < u)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * addressOf - spells the address with a given id; the same id always gives
+ * the same string
+ * @gen: pointer to generator settings
+ * @id: address id
+ * @out: buffer of DATASIZE_MAX bytes
+ */
+static void addressOf(generator_t *gen, long id, char *out)
+{
+    uint64_t state = gen->seed ^ ((uint64_t)id * 0xD1B54A32D192ED03ULL);
+    int len = gen->min_len + (int)(mix(&state) % (uint64_t)(gen->max_len - gen->min_len + 1));
+
+    for (int i = 0; i < len; i++)
+        out[i] = ADDRESS_ALPHABET[mix(&state) & 31];
+    out[len] = '\0';
+}
+
+/**
+ * randomTransaction - appends a random transaction to a list
+ * @gen: pointer to generator settings
+ * @state: pointer to generator state
+ * @list: pointer to list of transactions
+ * @fee: 1 to draw a fee, 0 for a fee of 0
+ * Return: 1 on success else 0
+ */
+static int randomTransaction(generator_t *gen, uint64_t *state, list_of_transactions *list, int fee)
+{
+    char sender[DATASIZE_MAX], receiver[DATASIZE_MAX], amount[20];
+    long from = zipfRank(gen, state);
+    long to = (long)(mix(state) % (uint64_t)gen->addresses);
+
+    addressOf(gen, gen->ids[from], sender);
+    addressOf(gen, to, receiver);
+    snprintf(amount, sizeof(amount), "%" PRIu64 ".%02" PRIu64, mix(state) % 100000, mix(state) % 100);
+    return appendTransaction(list, sender, receiver, amount, fee ? mix(state) % 1000 : 0);
+}
+
+/**
+ * searchWorker - scans every threads-th nonce of the current block, giving
+ * up once a smaller valid nonce has been found
+ * @arg: pointer to search_t, followed by the thread number
+ * Return: NULL
+ */
+static void *searchWorker(void *arg)
+{
+    search_t *search = ((void **)arg)[0];
+    uint64_t first = (uint64_t)(uintptr_t)((void **)arg)[1];
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+
+    for (;;)
+    {
+        uint64_t nonce, tried = 0;
+
+        pthread_barrier_wait(&search->start);
+        if (search->quit)
+            return NULL;
+        for (nonce = first; nonce < atomic_load_explicit(&search->best, memory_order_relaxed);
+             nonce += search->threads, tried++)
+        {
+            if (!calculateHash(search->block, nonce, hash))
+            {
+                search->failed = 1;
+                break;
+            }
+            if (is_valid_hash(hash, search->difficulty))
+            {
+                uint64_t best = atomic_load(&search->best);
+                while (nonce < best && !atomic_compare_exchange_weak(&search->best, &best, nonce))
+                    ;
+                tried++;
+                break;
+            }
+        }
+        atomic_fetch_add(&search->hashes, tried);
+        pthread_barrier_wait(&search->done);
+    }
+}
+
+/**
+ * sealBlock - finds the smallest nonce meeting the difficulty
+ * @search: pointer to search state shared with the workers
+ * @block: pointer to block to seal
+ * Return: 1 on success else 0
+ */
+static int sealBlock(search_t *search, block_t *block)
+{
+    if (search->difficulty > 0)
+    {
+        search->block = block;
+        atomic_store(&search->best, UINT64_MAX);
+        pthread_barrier_wait(&search->start);
+        pthread_barrier_wait(&search->done);
+        block->nonce = atomic_load(&search->best);
+        if (search->failed)
+            return 0;
+    }
+    else
+    {
+        block->nonce = 0;
+        atomic_fetch_add(&search->hashes, 1);
+    }
+    return calculateHash(block, block->nonce, block->currHash);
+}
+
+/**
+ * writeChain - generates, seals and streams the chain one block at a time
+ * @ctx: pointer to context
+ * @gen: pointer to generator settings
+ * @search: pointer to search state
+ * Return: 1 on success else 0
+ */
+static int writeChain(blockchain_ctx_t *ctx, generator_t *gen, search_t *search)
+{
+    record_t record = {0};
+    unsigned char prevHash[SHA256_DIGEST_LENGTH] = {0};
+    snapshot_t snapshot;
+    FILE *file = beginSnapshot(&snapshot, ctx->chain_path);
+    int ok;
+
+    if (!file)
+        return 0;
+
+    ok = writeFileHeader(file, BLOCKCHAIN_MAGIC, gen->difficulty > 0 ? gen->difficulty : INITIAL_DIFFICULTY);
+    for (long h = 0; ok && h < gen->blocks; h++)
+    {
+        uint64_t state = gen->seed ^ ((uint64_t)h * 0xA24BAED4963EE407ULL);
+        list_of_transactions *txs;
+        block_t *block;
+
+        if (h == 0)
+            txs = createTransactions("Genesis", "Blockchain", "0");
+        else
+        {
+            txs = newTransactions(gen->per_block);
+            for (int t = 0; txs && t < gen->per_block; t++)
+            {
+                if (!randomTransaction(gen, &state, txs, 0))
+                {
+                    freeTransactions(txs);
+                    txs = NULL;
+                }
+            }
+        }
+        block = txs ? prepareBlock((int)h, txs, prevHash) : NULL;
+        if (!block)
+        {
+            freeTransactions(txs);
+            ok = 0;
+            break;
+        }
+        block->timestamp = GENERATOR_EPOCH + (uint64_t)h * GENERATOR_BLOCK_TIME;
+        ok = sealBlock(search, block) && encodeBlock(&record, block) && writeRecord(file, &record);
+        memcpy(prevHash, block->currHash, SHA256_DIGEST_LENGTH);
+        freeTransactions(txs);
+        free(block);
+        if (h % 100000 == 99999)
+            fprintf(stderr, "%ld blocks written\n", h + 1);
+    }
+
+    freeRecord(&record);
+    return commitSnapshot(&snapshot, ok);
+}
+
+/**
+ * writePool - streams a pool of random fee paying transactions
+ * @ctx: pointer to context
+ * @gen: pointer to generator settings
+ * Return: 1 on success else 0
+ */
+static int writePool(blockchain_ctx_t *ctx, generator_t *gen)
+{
+    record_t record = {0};
+    list_of_transactions *one = newTransactions(1);
+    uint64_t state = gen->seed ^ 0x5851F42D4C957F2DULL;
+    snapshot_t snapshot;
+    FILE *file;
+    int ok;
+
+    if (!one)
+        return 0;
+    file = beginSnapshot(&snapshot, ctx->pool_path);
+    if (!file)
+    {
+        freeTransactions(one);
+        return 0;
+    }
+
+    ok = writeFileHeader(file, TRANSACTION_MAGIC, (int32_t)gen->pool);
+    for (long i = 0; ok && i < gen->pool; i++)
+    {
+        one->nb_trans = 0;
+        ok = randomTransaction(gen, &state, one, 1);
+        one->trans[0].index = (int)i;
+        record.len = 0;
+        ok = ok && encodeTransaction(&record, one, 0) && writeRecord(file, &record);
+    }
+
+    freeRecord(&record);
+    freeTransactions(one);
+    return commitSnapshot(&snapshot, ok);
+}
+
+/**
+ * usage - prints command line help
+ * @name: program name
+ */
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [-b blocks] [-t tx_per_block] [-p pool] [-a addresses]\n"
+            "       [-z zipf_exponent] [-l min_len[:max_len]] [-d difficulty]\n"
+            "       [-j threads] [-s seed]\n", name);
+}
+
+/**
+ * main - writes a synthetic blockchain and transaction pool
+ * @argc: argument count
+ * @argv: options, see usage
+ * Return: 0 on success
+ */
+int main(int argc, char **argv)
+{
+    generator_t gen = {1000, 10, 0, 10000, 1.0, 16, 40, 1, 0, 42, NULL, NULL};
+    search_t search = {0};
+    pthread_t *workers = NULL;
+    void *(*args)[2] = NULL;
+    time_t start = time(NULL);
+    int opt, lockFd, ok;
+    blockchain_ctx_t ctx;
+
+    gen.threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    while ((opt = getopt(argc, argv, "b:t:p:a:z:l:d:j:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b': gen.blocks = atol(optarg); break;
+        case 't': gen.per_block = atoi(optarg); break;
+        case 'p': gen.pool = atol(optarg); break;
+        case 'a': gen.addresses = atol(optarg); break;
+        case 'z': gen.zipf = atof(optarg); break;
+        case 'l':
+            if (sscanf(optarg, "%d:%d", &gen.min_len, &gen.max_len) == 1)
+                gen.max_len = gen.min_len;
+            break;
+        case 'd': gen.difficulty = atoi(optarg); break;
+        case 'j': gen.threads = atoi(optarg); break;
+        case 's': gen.seed = strtoull(optarg, NULL, 0); break;
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (gen.blocks < 1 || gen.blocks > INT32_MAX || gen.per_block < 0 || gen.pool < 0 ||
+        gen.addresses < 1 || gen.zipf < 0 || gen.min_len < 1 || gen.max_len < gen.min_len ||
+        gen.max_len >= DATASIZE_MAX || gen.difficulty < 0 || gen.difficulty > SHA256_DIGEST_LENGTH)
+    {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (gen.threads < 1)
+        gen.threads = 1;
+    if (!initContext(&ctx, NULL))
+    {
+        fprintf(stderr, "Could not set up blockchain context: %s\n", blockchainStrerror(blockchainError()));
+        exit(EXIT_FAILURE);
+    }
+    if (gen.pool > poolCapacity(&ctx))
+    {
+        fprintf(stderr, "Pool capped to its capacity (%d)\n", poolCapacity(&ctx));
+        gen.pool = poolCapacity(&ctx);
+    }
+    if (!buildZipf(&gen))
+    {
+        fprintf(stderr, "Failed to allocate memory for address distribution\n");
+        exit(EXIT_FAILURE);
+    }
+
+    search.difficulty = gen.difficulty;
+    search.threads = gen.threads;
+    workers = malloc(gen.threads * sizeof(*workers));
+    args = malloc(gen.threads * sizeof(*args));
+    if (!workers || !args ||
+        pthread_barrier_init(&search.start, NULL, gen.threads + 1) != 0 ||
+        pthread_barrier_init(&search.done, NULL, gen.threads + 1) != 0)
+    {
+        fprintf(stderr, "Could not set up mining threads\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < gen.threads; i++)
+    {
+        args[i][0] = &search;
+        args[i][1] = (void *)(uintptr_t)i;
+        if (pthread_create(&workers[i], NULL, searchWorker, args[i]) != 0)
+        {
+            fprintf(stderr, "Could not start mining thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    ok = writeChain(&ctx, &gen, &search);
+
+    search.quit = 1;
+    pthread_barrier_wait(&search.start);
+    for (int i = 0; i < gen.threads; i++)
+        pthread_join(workers[i], NULL);
+    pthread_barrier_destroy(&search.start);
+    pthread_barrier_destroy(&search.done);
+    free(workers);
+    free(args);
+
+    if (!ok)
+    {
+        fprintf(stderr, "Could not write blockchain: %s\n", blockchainStrerror(blockchainError()));
+        free(gen.cdf);
+        free(gen.ids);
+        exit(EXIT_FAILURE);
+    }
+
+    /* Replace the pool, dropping anything still queued for the old chain */
+    lockFd = lockUnspent(&ctx, 1);
+    ok = lockFd >= 0 && drainTransactionQueue(&ctx) && writePool(&ctx, &gen);
+    unlockUnspent(&ctx, lockFd);
+    closeContext(&ctx);
+    free(gen.cdf);
+    free(gen.ids);
+    if (!ok)
+    {
+        fprintf(stderr, "Could not write transaction pool: %s\n", blockchainStrerror(blockchainError()));
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Generated %ld blocks (%ld transactions) and a pool of %ld in %ld seconds, %" PRIu64 " hashes\n",
+           gen.blocks, (gen.blocks - 1) * gen.per_block + 1, gen.pool,
+           (long)(time(NULL) - start), atomic_load(&search.hashes));
+    return 0;
+}
@@ -0,0 +1,384 @@
+#include "blockchain.h"
+#include <errno.h>
+
+/*
+ * LATENCY_DATABASE starts with a file_header_t whose value is the number
+ * of stages, followed by the last block trace and one record per stage:
+ *   uint32 stage | uint64 count, min, max, sum | uint32 n | n * (uint32 bucket, uint64 count)
+ * Only non-empty buckets are stored, so the file stays small.
+ */
+
+#define LATENCY_HALF (1 << (LATENCY_SUB_BITS - 1))
+#define TRACE_RECORD_SIZE (sizeof(int) + 5 * sizeof(uint64_t))
+#define STAGE_RECORD_HEADER_SIZE (2 * sizeof(uint32_t) + 4 * sizeof(uint64_t))
+#define BUCKET_RECORD_SIZE (sizeof(uint32_t) + sizeof(uint64_t))
+
+/**
+ * latencyNow - reads the clock latency stamps are taken from
+ *
+ * Stamps are compared across processes (a transaction is stamped by
+ * add_transaction and traced by mine_block), hence the realtime clock.
+ * Return: nanoseconds since the epoch
+ */
+uint64_t latencyNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * bucketOf - finds the bucket counting a value
+ * @ns: value
+ * Return: bucket index below LATENCY_BUCKETS
+ */
+static int bucketOf(uint64_t ns)
+{
+    int shift;
+
+    if (ns < (1U << LATENCY_SUB_BITS))
+        return (int)ns;
+    shift = 63 - __builtin_clzll(ns) - LATENCY_SUB_BITS + 1;
+    return (1 << LATENCY_SUB_BITS) + (shift - 1) * LATENCY_HALF + (int)((ns >> shift) - LATENCY_HALF);
+}
+
+/**
+ * bucketHigh - largest value a bucket counts
+ * @bucket: bucket index
+ * Return: value
+ */
+static uint64_t bucketHigh(int bucket)
+{
+    int shift;
+    uint64_t sub;
+
+    if (bucket < (1 << LATENCY_SUB_BITS))
+        return (uint64_t)bucket;
+    bucket -= 1 << LATENCY_SUB_BITS;
+    shift = bucket / LATENCY_HALF + 1;
+    sub = (uint64_t)(bucket % LATENCY_HALF + LATENCY_HALF);
+    return (sub << shift) + ((1ULL << shift) - 1);
+}
+
+/**
+ * recordLatency - counts a value in a histogram
+ * @histogram: pointer to histogram
+ * @ns: latency in nanoseconds
+ */
+void recordLatency(latency_histogram_t *histogram, uint64_t ns)
+{
+    if (histogram->count == 0 || ns < histogram->min)
+        histogram->min = ns;
+    if (ns > histogram->max)
+        histogram->max = ns;
+    histogram->count++;
+    histogram->sum += ns;
+    histogram->buckets[bucketOf(ns)]++;
+}
+
+/**
+ * latencyPercentile - value below which a share of the counted values lie
+ * @histogram: pointer to histogram
+ * @percentile: share in percent, e.g. 99.9
+ * Return: upper bound of the bucket holding the percentile, within 1/64 of
+ * the exact value, or 0 for an empty histogram
+ */
+uint64_t latencyPercentile(const latency_histogram_t *histogram, double percentile)
+{
+    uint64_t rank, seen = 0;
+
+    if (histogram->count == 0)
+        return 0;
+    rank = (uint64_t)(percentile / 100 * (double)histogram->count + 0.999999);
+    if (rank < 1)
+        rank = 1;
+    if (rank > histogram->count)
+        rank = histogram->count;
+    for (int b = 0; b < LATENCY_BUCKETS; b++)
+    {
+        seen += histogram->buckets[b];
+        if (seen >= rank)
+        {
+            uint64_t high = bucketHigh(b);
+            return high > histogram->max ? histogram->max : high < histogram->min ? histogram->min : high;
+        }
+    }
+    return histogram->max;
+}
+
+/**
+ * latencyStageName - names a latency stage
+ * @stage: LATENCY_* stage
+ * Return: static string
+ */
+const char *latencyStageName(int stage)
+{
+    switch (stage)
+    {
+    case LATENCY_QUEUE: return "queue wait";
+    case LATENCY_MINING: return "mining";
+    case LATENCY_VALIDATION: return "validation";
+    case LATENCY_PERSISTENCE: return "persistence";
+    case LATENCY_TOTAL: return "end to end";
+    default: return "unknown";
+    }
+}
+
+/**
+ * encodeStage - encodes a stage histogram as a record payload
+ * @record: pointer to record buffer, overwritten
+ * @stage: LATENCY_* stage
+ * @histogram: pointer to histogram
+ * Return: 1 on success else 0
+ */
+static int encodeStage(record_t *record, uint32_t stage, const latency_histogram_t *histogram)
+{
+    uint32_t used = 0;
+    unsigned char *p;
+
+    for (int b = 0; b < LATENCY_BUCKETS; b++)
+        used += histogram->buckets[b] != 0;
+    record->len = STAGE_RECORD_HEADER_SIZE + used * BUCKET_RECORD_SIZE;
+    if (!reserveRecord(record, record->len))
+        return 0;
+    p = record->data;
+    memcpy(p, &stage, sizeof(stage));
+    p += sizeof(stage);
+    memcpy(p, &histogram->count, sizeof(histogram->count));
+    p += sizeof(histogram->count);
+    memcpy(p, &histogram->min, sizeof(histogram->min));
+    p += sizeof(histogram->min);
+    memcpy(p, &histogram->max, sizeof(histogram->max));
+    p += sizeof(histogram->max);
+    memcpy(p, &histogram->sum, sizeof(histogram->sum));
+    p += sizeof(histogram->sum);
+    memcpy(p, &used, sizeof(used));
+    p += sizeof(used);
+    for (uint32_t b = 0; b < LATENCY_BUCKETS; b++)
+    {
+        if (!histogram->buckets[b])
+            continue;
+        memcpy(p, &b, sizeof(b));
+        p += sizeof(b);
+        memcpy(p, &histogram->buckets[b], sizeof(histogram->buckets[b]));
+        p += sizeof(histogram->buckets[b]);
+    }
+    return 1;
+}
+
+/**
+ * decodeStage - decodes a record payload written by encodeStage
+ * @record: pointer to record
+ * @latency: pointer to latency whose stage histogram to fill
+ * Return: 1 on success else 0 if the payload is malformed
+ */
+static int decodeStage(const record_t *record, latency_t *latency)
+{
+    const unsigned char *p = record->data;
+    latency_histogram_t *histogram;
+    uint32_t stage, used;
+
+    if (record->len < STAGE_RECORD_HEADER_SIZE)
+        return 0;
+    memcpy(&stage, p, sizeof(stage));
+    p += sizeof(stage);
+    if (stage >= LATENCY_STAGES)
+        return 0;
+    histogram = &latency->stages[stage];
+    memcpy(&histogram->count, p, sizeof(histogram->count));
+    p += sizeof(histogram->count);
+    memcpy(&histogram->min, p, sizeof(histogram->min));
+    p += sizeof(histogram->min);
+    memcpy(&histogram->max, p, sizeof(histogram->max));
+    p += sizeof(histogram->max);
+    memcpy(&histogram->sum, p, sizeof(histogram->sum));
+    p += sizeof(histogram->sum);
+    memcpy(&used, p, sizeof(used));
+    p += sizeof(used);
+    if (used > LATENCY_BUCKETS || record->len != STAGE_RECORD_HEADER_SIZE + used * BUCKET_RECORD_SIZE)
+        return 0;
+    for (uint32_t i = 0; i < used; i++)
+    {
+        uint32_t b;
+        memcpy(&b, p, sizeof(b));
+        p += sizeof(b);
+        if (b >= LATENCY_BUCKETS)
+            return 0;
+        memcpy(&histogram->buckets[b], p, sizeof(histogram->buckets[b]));
+        p += sizeof(histogram->buckets[b]);
+    }
+    return 1;
+}
+
+/**
+ * encodeTrace - encodes a block trace as a record payload
+ * @record: pointer to record buffer, overwritten
+ * @trace: pointer to trace
+ * Return: 1 on success else 0
+ */
+static int encodeTrace(record_t *record, const block_trace_t *trace)
+{
+    const uint64_t stamps[5] = {trace->started, trace->found, trace->validated, trace->writing, trace->persisted};
+
+    record->len = TRACE_RECORD_SIZE;
+    if (!reserveRecord(record, record->len))
+        return 0;
+    memcpy(record->data, &trace->index, sizeof(trace->index));
+    memcpy(record->data + sizeof(trace->index), stamps, sizeof(stamps));
+    return 1;
+}
+
+/**
+ * decodeTrace - decodes a record payload written by encodeTrace
+ * @record: pointer to record
+ * @trace: pointer to trace to fill
+ * Return: 1 on success else 0 if the payload is malformed
+ */
+static int decodeTrace(const record_t *record, block_trace_t *trace)
+{
+    uint64_t stamps[5];
+
+    if (record->len != TRACE_RECORD_SIZE)
+        return 0;
+    memcpy(&trace->index, record->data, sizeof(trace->index));
+    memcpy(stamps, record->data + sizeof(trace->index), sizeof(stamps));
+    trace->started = stamps[0];
+    trace->found = stamps[1];
+    trace->validated = stamps[2];
+    trace->writing = stamps[3];
+    trace->persisted = stamps[4];
+    return 1;
+}
+
+/**
+ * loadLatency - reads the latency histograms of a chain
+ * @ctx: pointer to context
+ *
+ * A bad header or a corrupt or truncated record fails the load with
+ * BC_ECORRUPT, so the histograms are never written back partly reset;
+ * with ctx->salvage set, the stages read before it are kept instead.
+ * Return: pointer to latency (empty if the file is missing), or NULL on
+ * failure
+ */
+latency_t *loadLatency(blockchain_ctx_t *ctx)
+{
+    latency_t *latency = calloc(1, sizeof(*latency));
+    record_t record = {0};
+    int32_t stages;
+    int status, failed = 0;
+    FILE *file;
+
+    if (!latency)
+    {
+        blockchainFail(BC_ENOMEM);
+        return NULL;
+    }
+    latency->last.index = -1;
+    file = fopen(ctx->latency_path, "rb");
+    if (!file && errno == ENOENT)
+        return latency;
+    if (!file)
+    {
+        free(latency);
+        blockchainFail(BC_EIO);
+        return NULL;
+    }
+
+    status = readFileHeader(file, LATENCY_MAGIC, &stages);
+    if (status != RECORD_OK && status != RECORD_END)
+    {
+        logContext(ctx, "%s: %s in file header\n", ctx->latency_path, recordError(status));
+        failed = !ctx->salvage;
+    }
+    for (int i = 0; status == RECORD_OK; i++)
+    {
+        long offset = ftell(file);
+        status = readRecord(file, &record);
+        if (status == RECORD_OK && !(i == 0 ? decodeTrace(&record, &latency->last) : decodeStage(&record, latency)))
+            status = RECORD_CORRUPT;
+        if (status != RECORD_OK && status != RECORD_END)
+        {
+            logContext(ctx, "%s: %s at offset %ld, after %d good stages\n",
+                       ctx->latency_path, recordError(status), offset, i > 0 ? i - 1 : 0);
+            failed = !ctx->salvage;
+        }
+    }
+
+    freeRecord(&record);
+    fclose(file);
+    if (failed)
+    {
+        free(latency);
+        blockchainFail(BC_ECORRUPT);
+        return NULL;
+    }
+    return latency;
+}
+
+/**
+ * saveLatency - writes the latency histograms of a chain
+ * @ctx: pointer to context
+ * @latency: pointer to latency
+ * Return: 1 on success else 0
+ */
+int saveLatency(blockchain_ctx_t *ctx, const latency_t *latency)
+{
+    record_t record = {0};
+    snapshot_t snapshot;
+    int ok;
+
+    FILE *file = beginSnapshot(&snapshot, ctx->latency_path);
+    if (!file)
+        return 0;
+    ok = writeFileHeader(file, LATENCY_MAGIC, LATENCY_STAGES) &&
+         encodeTrace(&record, &latency->last) && writeRecord(file, &record);
+    for (uint32_t stage = 0; ok && stage < LATENCY_STAGES; stage++)
+        ok = encodeStage(&record, stage, &latency->stages[stage]) && writeRecord(file, &record);
+    freeRecord(&record);
+    return commitSnapshot(&snapshot, ok);
+}
+
+/**
+ * recordSpan - counts the time between two stamps, skipping spans a
+ * missing stamp or a clock step makes meaningless
+ * @histogram: pointer to histogram
+ * @from: earlier stamp
+ * @to: later stamp
+ */
+static void recordSpan(latency_histogram_t *histogram, uint64_t from, uint64_t to)
+{
+    if (from && to >= from)
+        recordLatency(histogram, to - from);
+}
+
+/**
+ * traceBlock - adds a persisted block to the latency histograms: its stage
+ * times, and the queue wait and end to end latency of its transactions;
+ * caller must hold the pool lock so concurrent miners do not lose updates
+ * @ctx: pointer to context
+ * @trace: pointer to stamps of the block
+ * @admitted: admission stamps of the block's transactions, 0 if unknown
+ * @count: number of transactions
+ * Return: 1 on success else 0
+ */
+int traceBlock(blockchain_ctx_t *ctx, const block_trace_t *trace, const uint64_t *admitted, int count)
+{
+    latency_t *latency = loadLatency(ctx);
+    int ok;
+
+    if (!latency)
+        return 0;
+    for (int i = 0; i < count; i++)
+    {
+        recordSpan(&latency->stages[LATENCY_QUEUE], admitted[i], trace->started);
+        recordSpan(&latency->stages[LATENCY_TOTAL], admitted[i], trace->persisted);
+    }
+    recordSpan(&latency->stages[LATENCY_MINING], trace->started, trace->found);
+    recordSpan(&latency->stages[LATENCY_VALIDATION], trace->found, trace->validated);
+    recordSpan(&latency->stages[LATENCY_PERSISTENCE], trace->writing, trace->persisted);
+    latency->last = *trace;
+    ok = saveLatency(ctx, latency);
+    free(latency);
+    return ok;
+}
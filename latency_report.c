@@ -0,0 +1,83 @@
+#include "blockchain.h"
+
+/**
+ * formatDuration - writes a duration with a readable unit
+ * @ns: duration in nanoseconds
+ * @out: buffer of 16 bytes
+ * Return: out
+ */
+static char *formatDuration(uint64_t ns, char *out)
+{
+    if (ns < 1000)
+        snprintf(out, 16, "%" PRIu64 "ns", ns);
+    else if (ns < 1000000)
+        snprintf(out, 16, "%.1fus", ns / 1e3);
+    else if (ns < 1000000000)
+        snprintf(out, 16, "%.1fms", ns / 1e6);
+    else
+        snprintf(out, 16, "%.2fs", ns / 1e9);
+    return out;
+}
+
+/**
+ * main - reports the latency of transactions and blocks on their way to
+ * the persisted chain
+ * @argc: argument count
+ * @argv: -r to clear the histograms after reporting them
+ * Return: 0 on success else EXIT_FAILURE
+ */
+int main(int argc, char **argv)
+{
+    int reset = argc > 1 && strcmp(argv[1], "-r") == 0;
+    char p50[16], p99[16], p999[16], max[16], mean[16];
+    blockchain_ctx_t ctx;
+    latency_t *latency;
+    int lockFd;
+
+    if (!initContext(&ctx, NULL))
+    {
+        fprintf(stderr, "Could not set up blockchain context: %s\n", blockchainStrerror(blockchainError()));
+        exit(EXIT_FAILURE);
+    }
+    ctx.log = stderr;
+    ctx.salvage = 1;  /* show what is left of damaged histograms, -r rewrites them */
+
+    /* Keep a concurrent mine_block from recording between the read and the reset */
+    lockFd = reset ? lockUnspent(&ctx, 1) : -1;
+    latency = loadLatency(&ctx);
+    if (!latency)
+    {
+        fprintf(stderr, "Could not read latency histograms: %s\n", blockchainStrerror(blockchainError()));
+        unlockUnspent(&ctx, lockFd);
+        closeContext(&ctx);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%-12s %10s %10s %10s %10s %10s %10s\n", "stage", "count", "mean", "p50", "p99", "p99.9", "max");
+    for (int stage = 0; stage < LATENCY_STAGES; stage++)
+    {
+        latency_histogram_t *h = &latency->stages[stage];
+        printf("%-12s %10" PRIu64 " %10s %10s %10s %10s %10s\n", latencyStageName(stage), h->count,
+               formatDuration(h->count ? h->sum / h->count : 0, mean),
+               formatDuration(latencyPercentile(h, 50), p50),
+               formatDuration(latencyPercentile(h, 99), p99),
+               formatDuration(latencyPercentile(h, 99.9), p999),
+               formatDuration(h->max, max));
+    }
+    if (latency->last.index >= 0)
+        printf("\nLast block %d: mined in %s, validated in %s, persisted in %s\n", latency->last.index,
+               formatDuration(latency->last.found - latency->last.started, p50),
+               formatDuration(latency->last.validated - latency->last.found, p99),
+               formatDuration(latency->last.persisted - latency->last.writing, p999));
+
+    if (reset)
+    {
+        memset(latency->stages, 0, sizeof(latency->stages));
+        if (!saveLatency(&ctx, latency))
+            fprintf(stderr, "Could not reset latency histograms: %s\n", blockchainStrerror(blockchainError()));
+        unlockUnspent(&ctx, lockFd);
+    }
+    free(latency);
+    closeContext(&ctx);
+    return 0;
+}
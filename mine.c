@@ -1,4 +1,42 @@
+#define _GNU_SOURCE  /* SCHED_IDLE, CPU_COUNT, gettid */
 #include "blockchain.h"
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#define NSEC_PER_SEC 1000000000ULL
+#define MINING_PERIOD_NS (MINING_PERIOD_MS * 1000000ULL)
+#define MINING_CHECK_NS 100000ULL  /* CPU time hashed between clock reads */
+
+/* State shared by the threads mining one block */
+typedef struct miner_s {
+    block_t *block;
+    int difficulty;
+    int threads;
+    int idle;
+    uint64_t slice;                 /* CPU nanoseconds per period for each thread */
+    uint64_t base;                  /* first nonce of the round */
+    uint64_t chunks;                /* MINING_CHUNK sized chunks in the round */
+    _Atomic uint64_t nextChunk;
+    _Atomic int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t stopped;         /* wakes the controller when stop is set */
+    _Atomic int failed;
+    _Atomic int exhausted;
+    _Atomic uint64_t nonce;         /* smallest nonce found, UINT64_MAX until then */
+    _Atomic int active;             /* threads allowed to run, the others park */
+    _Atomic uint64_t hashes;
+    _Atomic uint64_t cpuNanos;
+    _Atomic uint64_t progress[MINING_MAX_THREADS];  /* next nonce of each thread's chunk */
+} miner_t;
+
+typedef struct miner_thread_s {
+    miner_t *miner;
+    int id;
+} miner_thread_t;
 
 /**
  * hash_to_hex - converts binary hash to hex string
@@ -32,83 +70,541 @@ int is_valid_hash(unsigned char *hash, int difficulty)
 /**
  * calculateHash - calculates the hash of a block
  * @block: pointer to block to calculate hash of
+ * @nonce: nonce to hash the block with
  * @hash: pointer to address to store hash
- * Return: Nothing
+ * Return: 1 on success else 0
  */
-void calculateHash(block_t *block, unsigned int nonce, unsigned char *hash)
+int calculateHash(block_t *block, uint64_t nonce, unsigned char *hash)
 {
-    transaction_t *current_trans;
+    list_of_transactions *transactions = block->transactions;
+    int ok;
+
+    /* No transactions */
+    if (!transactions)
+        return blockchainFail(BC_EINVAL);
 
     EVP_MD_CTX *ctx = EVP_MD_CTX_new();
-    if (!ctx) {
-        fprintf(stderr, "Failed to create EVP_MD_CTX\n");
-        exit(EXIT_FAILURE);
-    }
+    if (!ctx)
+        return blockchainFail(BC_ENOMEM);
+
+    /* Adding block elements and nonce to hash calculation */
+    ok = EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) == 1 &&
+         EVP_DigestUpdate(ctx, &block->index, sizeof(block->index)) == 1 &&
+         EVP_DigestUpdate(ctx, &block->timestamp, sizeof(block->timestamp)) == 1 &&
+         EVP_DigestUpdate(ctx, block->prevHash, SHA256_DIGEST_LENGTH) == 1 &&
+         EVP_DigestUpdate(ctx, &nonce, sizeof(nonce)) == 1;
 
-    /* Adding block elements to hash calculation */
-    if (EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1 ||
-        EVP_DigestUpdate(ctx, &block->index, sizeof(block->index)) != 1 ||
-        EVP_DigestUpdate(ctx, &block->timestamp, sizeof(block->timestamp)) != 1 ||
-        EVP_DigestUpdate(ctx, block->prevHash, SHA256_DIGEST_LENGTH) != 1) {
-        fprintf(stderr, "Failed to calculate hash\n");
-        EVP_MD_CTX_free(ctx);
-        exit(EXIT_FAILURE);
+    /* adding block's transactions to hash*/
+    for (int i = 0; ok && i < transactions->nb_trans; i++) {
+        ok = EVP_DigestUpdate(ctx, transactions->payloads[i].sender, sizeof(transactions->payloads[i].sender)) == 1 &&
+             EVP_DigestUpdate(ctx, transactions->payloads[i].receiver, sizeof(transactions->payloads[i].receiver)) == 1 &&
+             EVP_DigestUpdate(ctx, transactions->trans[i].amount, sizeof(transactions->trans[i].amount)) == 1 &&
+             EVP_DigestUpdate(ctx, &transactions->trans[i].fee, sizeof(transactions->trans[i].fee)) == 1;
     }
 
-    /* Adding nonce to hash calculation */
-    if (EVP_DigestUpdate(ctx, &nonce, sizeof(nonce)) != 1) {
-        fprintf(stderr, "Failed to calculate hash with nonce\n");
-        EVP_MD_CTX_free(ctx);
-        exit(EXIT_FAILURE);
+    ok = ok && EVP_DigestFinal_ex(ctx, hash, NULL) == 1;
+    EVP_MD_CTX_free(ctx);
+    return ok || blockchainFail(BC_ECRYPTO);
+}
+
+
+/**
+ * digestTransactions - hashes a block's transactions only, used to tell
+ * whether a mining checkpoint belongs to the block being mined
+ * @block: pointer to block
+ * @digest: pointer to address to store digest
+ * Return: 1 on success else 0
+ */
+static int digestTransactions(block_t *block, unsigned char *digest)
+{
+    list_of_transactions *transactions = block->transactions;
+    int ok;
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+
+    if (!ctx)
+        return 0;
+    ok = EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) == 1;
+    for (int i = 0; ok && transactions && i < transactions->nb_trans; i++) {
+        ok = EVP_DigestUpdate(ctx, transactions->payloads[i].sender, sizeof(transactions->payloads[i].sender)) == 1 &&
+             EVP_DigestUpdate(ctx, transactions->payloads[i].receiver, sizeof(transactions->payloads[i].receiver)) == 1 &&
+             EVP_DigestUpdate(ctx, transactions->trans[i].amount, sizeof(transactions->trans[i].amount)) == 1 &&
+             EVP_DigestUpdate(ctx, &transactions->trans[i].fee, sizeof(transactions->trans[i].fee)) == 1;
     }
+    ok = ok && EVP_DigestFinal_ex(ctx, digest, NULL) == 1;
+    EVP_MD_CTX_free(ctx);
+    return ok;
+}
 
-    /* No transactions */
-    if (!block->transactions)
+/**
+ * saveCheckpoint - atomically records mining progress so an interrupted
+ * search can resume where it stopped
+ * @ctx: pointer to context
+ * @checkpoint: pointer to progress to save
+ * Return: 1 on success else 0
+ */
+static int saveCheckpoint(blockchain_ctx_t *ctx, const mining_checkpoint_t *checkpoint)
+{
+    snapshot_t snapshot;
+    FILE *file = beginSnapshot(&snapshot, ctx->checkpoint_path);
+
+    if (!file)
+        return 0;
+    return commitSnapshot(&snapshot, fwrite(checkpoint, sizeof(*checkpoint), 1, file) == 1);
+}
+
+/**
+ * loadCheckpoint - reads mining progress for a block
+ * @ctx: pointer to context
+ * @block: pointer to block about to be mined
+ * @checkpoint: pointer to address to store progress, initialized from
+ * block when no matching checkpoint exists
+ * Return: 1 if a matching checkpoint was found else 0
+ */
+static int loadCheckpoint(blockchain_ctx_t *ctx, block_t *block, mining_checkpoint_t *checkpoint)
+{
+    mining_checkpoint_t saved;
+    FILE *file;
+    int found = 0;
+
+    memset(checkpoint, 0, sizeof(*checkpoint));
+    checkpoint->index = block->index;
+    checkpoint->timestamp = block->timestamp;
+    memcpy(checkpoint->prevHash, block->prevHash, SHA256_DIGEST_LENGTH);
+    if (!digestTransactions(block, checkpoint->txDigest))
+        return 0;
+
+    file = fopen(ctx->checkpoint_path, "rb");
+    if (!file)
+        return 0;
+    if (fread(&saved, sizeof(saved), 1, file) == 1 &&
+        saved.index == checkpoint->index &&
+        memcmp(saved.prevHash, checkpoint->prevHash, SHA256_DIGEST_LENGTH) == 0 &&
+        memcmp(saved.txDigest, checkpoint->txDigest, SHA256_DIGEST_LENGTH) == 0)
     {
-    EVP_MD_CTX_free(ctx);
-    fprintf(stderr, "Block has no transactions!\n");
-    exit(EXIT_FAILURE);
+        *checkpoint = saved;
+        found = 1;
     }
+    fclose(file);
+    return found;
+}
 
-    /* adding block's transactions to hash*/
-    current_trans = block->transactions->head;
-    while (current_trans) {
-        EVP_DigestUpdate(ctx, current_trans->sender, sizeof(current_trans->sender));
-        EVP_DigestUpdate(ctx, current_trans->receiver, sizeof(current_trans->receiver));
-        EVP_DigestUpdate(ctx, current_trans->amount, sizeof(current_trans->amount));
-        current_trans = current_trans->next;
+/**
+ * clockNanos - reads a clock
+ * @clock: clock id
+ * Return: time in nanoseconds
+ */
+static uint64_t clockNanos(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * sleepUntil - sleeps until a CLOCK_MONOTONIC deadline
+ * @deadline: deadline in nanoseconds
+ */
+static void sleepUntil(uint64_t deadline)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(deadline / NSEC_PER_SEC);
+    ts.tv_nsec = (long)(deadline % NSEC_PER_SEC);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+        ;
+}
+
+/**
+ * availableCores - CPU time this process may use, from its CPU affinity
+ * and its cgroup v2 cpu.max quota
+ * Return: number of cores, possibly fractional
+ */
+static double availableCores(void)
+{
+    char line[CONTEXT_PATH_MAX], path[CONTEXT_PATH_MAX + 64] = "/sys/fs/cgroup/cpu.max";
+    double cores;
+    cpu_set_t set;
+    FILE *file;
+
+    cores = sched_getaffinity(0, sizeof(set), &set) == 0 ? CPU_COUNT(&set) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1)
+        cores = 1;
+
+    /* "0::/path" names our cgroup; inside a cgroup namespace it is "/" */
+    file = fopen("/proc/self/cgroup", "r");
+    if (file)
+    {
+        while (fgets(line, sizeof(line), file))
+        {
+            if (strncmp(line, "0::", 3) != 0)
+                continue;
+            line[strcspn(line, "\n")] = '\0';
+            snprintf(path, sizeof(path), "/sys/fs/cgroup%s/cpu.max", strcmp(line + 3, "/") ? line + 3 : "");
+            break;
+        }
+        fclose(file);
+    }
+    file = fopen(path, "r");
+    if (file)
+    {
+        long quota, period;
+        if (fscanf(file, "%ld %ld", &quota, &period) == 2 && quota > 0 && period > 0 &&
+            (double)quota / period < cores)
+            cores = (double)quota / period;
+        fclose(file);
     }
+    return cores;
+}
+
+/**
+ * yieldPriority - lets any other work on the host run before this thread
+ */
+static void yieldPriority(void)
+{
+    struct sched_param param = {0};
+
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0)
+        setpriority(PRIO_PROCESS, (id_t)gettid(), 19);
+}
 
-    if (EVP_DigestFinal_ex(ctx, hash, NULL) != 1) {
-        fprintf(stderr, "Failed to finalize hash\n");
-        EVP_MD_CTX_free(ctx);
-        exit(EXIT_FAILURE);
+/**
+ * stopRound - ends the current round and wakes the controller
+ * @m: pointer to miner
+ */
+static void stopRound(miner_t *m)
+{
+    pthread_mutex_lock(&m->lock);
+    atomic_store(&m->stop, 1);
+    pthread_cond_signal(&m->stopped);
+    pthread_mutex_unlock(&m->lock);
+}
+
+/**
+ * waitRound - waits for the round to stop or a deadline to pass
+ * @m: pointer to miner
+ * @deadline: CLOCK_MONOTONIC deadline in nanoseconds
+ * Return: 1 if the round stopped else 0
+ */
+static int waitRound(miner_t *m, uint64_t deadline)
+{
+    struct timespec ts;
+    int stopped;
+
+    ts.tv_sec = (time_t)(deadline / NSEC_PER_SEC);
+    ts.tv_nsec = (long)(deadline % NSEC_PER_SEC);
+    pthread_mutex_lock(&m->lock);
+    while (!atomic_load(&m->stop) && pthread_cond_timedwait(&m->stopped, &m->lock, &ts) == 0)
+        ;
+    stopped = atomic_load(&m->stop);
+    pthread_mutex_unlock(&m->lock);
+    return stopped;
+}
+
+/**
+ * minerThread - hashes claimed nonce chunks within its CPU slice of every
+ * period, parking while the controller has it inactive
+ * @arg: pointer to miner_thread_t
+ * Return: NULL
+ */
+static void *minerThread(void *arg)
+{
+    miner_thread_t *self = arg;
+    miner_t *m = self->miner;
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    uint64_t cpuStart = clockNanos(CLOCK_THREAD_CPUTIME_ID);
+    uint64_t next = 0, end = 0, hashes = 0, batch = 1;
+
+    if (m->idle)
+        yieldPriority();
+
+    while (!atomic_load_explicit(&m->stop, memory_order_relaxed))
+    {
+        uint64_t periodStart = clockNanos(CLOCK_MONOTONIC);
+        uint64_t sliceStart = clockNanos(CLOCK_THREAD_CPUTIME_ID), cpu = sliceStart;
+
+        if (self->id >= atomic_load_explicit(&m->active, memory_order_relaxed))
+        {
+            sleepUntil(periodStart + MINING_PERIOD_NS);
+            continue;
+        }
+
+        /* Run until the slice is used up or the period is over, whichever comes first */
+        for (int done = 0; !done && !atomic_load_explicit(&m->stop, memory_order_relaxed);)
+        {
+            if (next == end)
+            {
+                /*
+                 * Hold the checkpoint back to the chunk about to be claimed
+                 * before claiming it, so it never sees nextChunk past a
+                 * chunk nobody has published progress for
+                 */
+                uint64_t chunk = atomic_load(&m->nextChunk);
+                atomic_store(&m->progress[self->id], m->base + (chunk < m->chunks ? chunk : m->chunks) * MINING_CHUNK);
+                chunk = atomic_fetch_add(&m->nextChunk, 1);
+                if (chunk >= m->chunks)
+                {
+                    atomic_store(&m->exhausted, 1);
+                    stopRound(m);
+                    break;
+                }
+                next = m->base + chunk * MINING_CHUNK;
+                end = next + MINING_CHUNK;
+            }
+            uint64_t n = 0;
+            for (; n < batch && next != end; n++, next++)
+            {
+                if (!calculateHash(m->block, next, hash))
+                {
+                    atomic_store(&m->failed, 1);
+                    stopRound(m);
+                    break;
+                }
+                if (is_valid_hash(hash, m->difficulty))
+                {
+                    uint64_t best = atomic_load(&m->nonce);
+                    while (next < best && !atomic_compare_exchange_weak(&m->nonce, &best, next))
+                        ;
+                    stopRound(m);
+                    break;
+                }
+            }
+            hashes += n;
+            atomic_store_explicit(&m->progress[self->id], next == end ? UINT64_MAX : next, memory_order_relaxed);
+
+            /*
+             * Size the next batch from the measured cost of a hash, which
+             * grows with the block: about MINING_CHECK_NS of work, and
+             * never past the end of the slice
+             */
+            uint64_t now = clockNanos(CLOCK_THREAD_CPUTIME_ID);
+            if (n)
+            {
+                uint64_t perHash = (now - cpu) / n, used = now - sliceStart;
+                if (perHash < 1)
+                    perHash = 1;
+                batch = MINING_CHECK_NS / perHash;
+                if (used < m->slice && batch > (m->slice - used) / perHash)
+                    batch = (m->slice - used) / perHash;
+                if (batch < 1)
+                    batch = 1;
+            }
+            cpu = now;
+            done = now - sliceStart >= m->slice ||
+                   clockNanos(CLOCK_MONOTONIC) - periodStart >= MINING_PERIOD_NS;
+        }
+        atomic_fetch_add_explicit(&m->hashes, hashes, memory_order_relaxed);
+        hashes = 0;
+        if (!atomic_load_explicit(&m->stop, memory_order_relaxed))
+            sleepUntil(periodStart + MINING_PERIOD_NS);
     }
 
-    EVP_MD_CTX_free(ctx);
+    atomic_fetch_add(&m->hashes, hashes);
+    atomic_fetch_add(&m->cpuNanos, clockNanos(CLOCK_THREAD_CPUTIME_ID) - cpuStart);
+    return NULL;
 }
 
+/**
+ * allowedThreads - how many mining threads may run given the load of the
+ * rest of the host
+ * @m: pointer to miner
+ * @cores: cores the process may use
+ * Return: number of threads, at least 1
+ */
+static int allowedThreads(miner_t *m, double cores)
+{
+    double load, duty = (double)m->slice / MINING_PERIOD_NS;
+    double others;
+    int allowed;
+
+    if (m->threads == 1 || getloadavg(&load, 1) != 1)
+        return m->threads;
+    /* The load average counts our own runnable threads too */
+    others = load - atomic_load(&m->active) * duty;
+    allowed = (int)((cores - (others > 0 ? others : 0)) / duty);
+    return allowed < 1 ? 1 : allowed > m->threads ? m->threads : allowed;
+}
+
+/**
+ * checkpointNonce - lowest nonce not yet known to be hashed
+ * @m: pointer to miner
+ * Return: nonce to resume from
+ */
+static uint64_t checkpointNonce(miner_t *m)
+{
+    uint64_t chunk = atomic_load(&m->nextChunk);
+    uint64_t nonce = m->base + (chunk < m->chunks ? chunk : m->chunks) * MINING_CHUNK;
+
+    for (int i = 0; i < m->threads; i++)
+    {
+        uint64_t p = atomic_load(&m->progress[i]);
+        if (p < nonce)
+            nonce = p;
+    }
+    return nonce;
+}
 
 /**
- * mine_block - mines a block in a blockchain
+ * mineBlockWithBudget - mines a block with threads held to a CPU budget
+ * @ctx: pointer to context, whose checkpoint file it uses; mine one block
+ * per context at a time
  * @block: pointer to block to mine
  * @difficulty: PoW difficulty level
- * Return: Nothing
+ * @budget: CPU budget and priority, NULL for one full core
+ * @stats: pointer to address to store what the run used, or NULL
+ *
+ * ceil(cores) threads are started, capped by the CPUs the process may run
+ * on and its cgroup cpu.max quota. Each gets cores / threads of every
+ * MINING_PERIOD_MS of CPU time and sleeps for the rest, and threads are
+ * parked while the load average shows the host busy with other work.
+ *
+ * The nonce space is 64 bits wide. Should it ever be exhausted the
+ * timestamp is rolled forward and the search restarts, so every
+ * difficulty terminates. Progress is checkpointed every
+ * CHECKPOINT_INTERVAL attempts and picked up again if the same block is
+ * mined after an interruption.
+ * Return: 1 on success else 0
  */
-void mine_block(block_t *block, int difficulty) 
+int mineBlockWithBudget(blockchain_ctx_t *ctx, block_t *block, int difficulty, const mining_budget_t *budget, mining_stats_t *stats)
 {
-    unsigned int nonce = 0;
-    unsigned char hash[SHA256_DIGEST_LENGTH];
+    static const mining_budget_t fullCore = {1.0, 0};
+    mining_checkpoint_t checkpoint;
+    pthread_t tids[MINING_MAX_THREADS];
+    pthread_condattr_t condattr;
+    miner_thread_t args[MINING_MAX_THREADS];
+    miner_t *m;
+    uint64_t wallStart = clockNanos(CLOCK_MONOTONIC), saved = 0;
+    double cores, available = availableCores();
+    int ok = 1, found = 0;
+
+    if (!budget)
+        budget = &fullCore;
+    cores = budget->cores > 0 ? budget->cores : 1.0;
+    if (cores > available)
+        cores = available;
+
+    m = calloc(1, sizeof(*m));
+    if (!m)
+        return blockchainFail(BC_ENOMEM);
+    pthread_condattr_init(&condattr);
+    pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    if (pthread_mutex_init(&m->lock, NULL) != 0 || pthread_cond_init(&m->stopped, &condattr) != 0)
+    {
+        pthread_condattr_destroy(&condattr);
+        free(m);
+        return blockchainFail(BC_ENOMEM);
+    }
+    pthread_condattr_destroy(&condattr);
+    m->block = block;
+    m->difficulty = difficulty;
+    m->idle = budget->idle;
+    m->threads = (int)ceil(cores);
+    if (m->threads > MINING_MAX_THREADS)
+        m->threads = MINING_MAX_THREADS;
+    m->slice = (uint64_t)(cores / m->threads * MINING_PERIOD_NS);
+
+    if (loadCheckpoint(ctx, block, &checkpoint))
+    {
+        logContext(ctx, "Resuming block %d from nonce %" PRIu64 "\n", block->index, checkpoint.nonce);
+        block->timestamp = checkpoint.timestamp;
+    }
+    m->base = checkpoint.nonce;
+
+    logContext(ctx, "Mining block %d at difficulty %d...\n", block->index, difficulty);
+    if (budget != &fullCore)
+        logContext(ctx, "Budget: %.2f cores over %d threads%s\n", cores, m->threads, m->idle ? ", idle priority" : "");
 
-    printf("Mining block %d at difficulty %d...\n", block->index, difficulty);
+    while (ok && !found)
+    {
+        int started = 0;
 
-    do {
-        block->nonce = nonce;
-        calculateHash(block, nonce, hash);
-        nonce++;
-    } while (!is_valid_hash(hash, difficulty));
+        /* A round covers the rest of the nonce space from base */
+        m->chunks = (UINT64_MAX - m->base) / MINING_CHUNK;
+        atomic_store(&m->nextChunk, 0);
+        atomic_store(&m->stop, 0);
+        atomic_store(&m->exhausted, 0);
+        atomic_store(&m->nonce, UINT64_MAX);
+        atomic_store(&m->active, m->threads);
+        for (int i = 0; i < m->threads; i++)
+            atomic_store(&m->progress[i], UINT64_MAX);
+        for (; started < m->threads; started++)
+        {
+            args[started].miner = m;
+            args[started].id = started;
+            if (pthread_create(&tids[started], NULL, minerThread, &args[started]) != 0)
+                break;
+        }
+        if (started == 0)
+        {
+            ok = blockchainFail(BC_ENOMEM);
+            break;
+        }
+        if (started < m->threads)
+            atomic_store(&m->active, started);
 
-    memcpy(block->currHash, hash, SHA256_DIGEST_LENGTH);
+        /* Controller: adapt to the load and checkpoint until a thread stops the round */
+        for (uint64_t tick = clockNanos(CLOCK_MONOTONIC) + MINING_PERIOD_NS;
+             !waitRound(m, tick); tick += MINING_PERIOD_NS)
+        {
+            if (started == m->threads)
+                atomic_store(&m->active, allowedThreads(m, cores));
+            if (atomic_load(&m->hashes) - saved >= CHECKPOINT_INTERVAL)
+            {
+                saved = atomic_load(&m->hashes);
+                checkpoint.timestamp = block->timestamp;
+                checkpoint.nonce = checkpointNonce(m);
+                if (!saveCheckpoint(ctx, &checkpoint))
+                    logContext(ctx, "Could not save mining checkpoint\n");
+            }
+        }
+        for (int i = 0; i < started; i++)
+            pthread_join(tids[i], NULL);
 
-    printf("Block %d mined with nonce: %u\n", block->index, nonce - 1);
-}
\ No newline at end of file
+        if (atomic_load(&m->failed))
+            ok = 0;
+        else if (atomic_load(&m->nonce) != UINT64_MAX)
+            found = 1;
+        else
+        {
+            /* Nonce space exhausted: roll the timestamp to get fresh work */
+            uint64_t now = (uint64_t)time(NULL);
+            block->timestamp = now > block->timestamp ? now : block->timestamp + 1;
+            m->base = 0;
+        }
+    }
+
+    if (stats)
+    {
+        stats->hashes = atomic_load(&m->hashes);
+        stats->wall_seconds = (double)(clockNanos(CLOCK_MONOTONIC) - wallStart) / NSEC_PER_SEC;
+        stats->cpu_seconds = (double)atomic_load(&m->cpuNanos) / NSEC_PER_SEC;
+        stats->threads = m->threads;
+    }
+    if (found)
+    {
+        block->nonce = atomic_load(&m->nonce);
+        ok = calculateHash(block, block->nonce, block->currHash);
+    }
+    pthread_cond_destroy(&m->stopped);
+    pthread_mutex_destroy(&m->lock);
+    free(m);
+    if (!ok)
+        return 0;
+
+    remove(ctx->checkpoint_path);
+    logContext(ctx, "Block %d mined with nonce: %" PRIu64 "\n", block->index, block->nonce);
+    return 1;
+}
+
+/**
+ * mine_block - mines a block in a blockchain on one full core
+ * @ctx: pointer to context, whose checkpoint file it uses; mine one block
+ * per context at a time
+ * @block: pointer to block to mine
+ * @difficulty: PoW difficulty level
+ * Return: 1 on success else 0
+ */
+int mine_block(blockchain_ctx_t *ctx, block_t *block, int difficulty)
+{
+    return mineBlockWithBudget(ctx, block, difficulty, NULL, NULL);
+}
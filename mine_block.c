@@ -1,34 +1,127 @@
 #include "blockchain.h"
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * parseBudget - reads a CPU budget given as cores ("1.5") or as a
+ * percentage of one core ("50%")
+ * @arg: option argument
+ * @cores: pointer to address to store the number of cores
+ * Return: 1 on success else 0
+ */
+static int parseBudget(const char *arg, double *cores)
+{
+    char *end;
+    double value = strtod(arg, &end);
+
+    if (end == arg || value <= 0)
+        return 0;
+    if (*end == '%')
+    {
+        value /= 100;
+        end++;
+    }
+    *cores = value;
+    return *end == '\0';
+}
 
 /**
  * main - mines new block and adds it to blockchain
+ * @argc: argument count
+ * @argv: options
+ *   -d           hand the search out to mine_worker processes instead of
+ *                mining in this process
+ *   -c budget    CPU to mine with, in cores ("2", "0.5") or percent of one
+ *                core ("50%"); default one full core
+ *   -i           mine at idle priority so any other work runs first
+ *   -r           repair: keep the good part of a damaged chain, pool or
+ *                latency file and write it back, instead of refusing
  * return: 0 always
  */
-int main(void)
+int main(int argc, char **argv)
 {
+    mining_budget_t budget = {1.0, 0};
+    mining_stats_t stats = {0};
+    block_trace_t trace = {0};
+    uint64_t *admitted;
+    int distributed = 0, budgeted = 0, repair = 0, opt;
     Blockchain *blockchain;
     block_t *newBlock;
     uint64_t startTime, endTime;
     list_of_transactions *unspent;
+    tx_pool_t *pool;
+    struct stat st;
+    int lockFd, nb_mined, *mined;
+    blockchain_ctx_t ctx;
+
+    while ((opt = getopt(argc, argv, "dc:ir")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            distributed = 1;
+            break;
+        case 'c':
+            if (!parseBudget(optarg, &budget.cores))
+            {
+                fprintf(stderr, "Invalid CPU budget: %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            budgeted = 1;
+            break;
+        case 'i':
+            budget.idle = 1;
+            budgeted = 1;
+            break;
+        case 'r':
+            repair = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-d] [-c cores|percent%%] [-i] [-r]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    blockchain = deserializeBlockchain();
+    if (!initContext(&ctx, NULL))
+    {
+        fprintf(stderr, "Could not set up blockchain context: %s\n", blockchainStrerror(blockchainError()));
+        exit(EXIT_FAILURE);
+    }
+    ctx.log = stdout;
+    ctx.salvage = repair;
+
+    blockchain = deserializeBlockchain(&ctx);
     if (!blockchain)
     {
-        fprintf(stderr, "Could not deserialize blockchain\n");
+        fprintf(stderr, "Could not deserialize blockchain: %s%s\n", blockchainStrerror(blockchainError()),
+                blockchainError() == BC_ECORRUPT ? " (run with -r to keep its good blocks)" : "");
         exit(EXIT_FAILURE);
     }
 
-    if (!blockchain->tail)
+    if (blockchain->length == 0)
     {
         fprintf(stderr, "Blockchain is empty. Initializing new blockchain...\n");
         freeBlockchain(blockchain);
-        blockchain = initBlockchain();
+        blockchain = initBlockchain(&ctx);
+        if (!blockchain)
+        {
+            fprintf(stderr, "Could not initialize blockchain: %s\n", blockchainStrerror(blockchainError()));
+            exit(EXIT_FAILURE);
+        }
     }
 
-    unspent = deserializeUnspent();
+    /* Take the highest fee transactions of the pool, including anything still queued */
+    lockFd = lockUnspent(&ctx, 1);
+    if (lockFd < 0 || !drainTransactionQueue(&ctx))
+        fprintf(stderr, "Could not drain transaction queue\n");
+    pool = loadPool(&ctx);
+    unspent = pool ? poolTakeTop(pool, ctx.block_max_transactions) : NULL;
+    freePool(pool);
+    unlockUnspent(&ctx, lockFd);
     if (!unspent)
     {
-        fprintf(stderr, "Could not deserialize unspent transactions\n");
+        fprintf(stderr, "Could not deserialize unspent transactions: %s%s\n", blockchainStrerror(blockchainError()),
+                blockchainError() == BC_ECORRUPT ? " (run with -r to keep its good entries)" : "");
         freeBlockchain(blockchain);
         exit(EXIT_FAILURE);
     }
@@ -41,63 +134,133 @@ int main(void)
         exit(EXIT_FAILURE);
     }
 
+    /*
+     * Remember the pool indices and admission stamps of what is mined, then
+     * number the transactions within the block
+     */
+    nb_mined = unspent->nb_trans;
+    mined = malloc(nb_mined * sizeof(*mined));
+    admitted = malloc(nb_mined * sizeof(*admitted));
+    if (!mined || !admitted)
+    {
+        fprintf(stderr, "Failed to allocate memory for mined indices\n");
+        freeBlockchain(blockchain);
+        freeTransactions(unspent);
+        free(mined);
+        free(admitted);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < nb_mined; i++)
+    {
+        mined[i] = unspent->trans[i].index;
+        admitted[i] = unspent->payloads[i].admitted;
+        unspent->trans[i].index = i;
+    }
     printf("------MINING BLOCK------\n");
     startTime = (uint64_t)time(NULL);
+    trace.index = blockchain->length;
+    trace.started = latencyNow();
 
-    newBlock = createBlock(blockchain->length, unspent, blockchain->tail ? blockchain->tail->currHash : NULL, blockchain->difficulty);
+    newBlock = prepareBlock(blockchain->length, unspent, getBlock(blockchain, blockchain->length - 1)->currHash);
+    if (newBlock && !(distributed ? coordinateMining(&ctx, newBlock, blockchain->difficulty) :
+                      mineBlockWithBudget(&ctx, newBlock, blockchain->difficulty, budgeted ? &budget : NULL, &stats)))
+    {
+        free(newBlock);
+        newBlock = NULL;
+    }
     if (!newBlock)
     {
-        fprintf(stderr, "Could not create new block\n");
+        fprintf(stderr, "Could not create new block: %s\n", blockchainStrerror(blockchainError()));
         freeBlockchain(blockchain);
         freeTransactions(unspent);
+        free(mined);
+        free(admitted);
         exit(EXIT_FAILURE);
     }
 
+    trace.found = latencyNow();
     endTime = (uint64_t)time(NULL);
-    addBlock(blockchain, newBlock);
-    printf("Time taken to mine block: %lu seconds\n", (endTime - startTime));
+    if (!addBlock(blockchain, newBlock))
+    {
+        fprintf(stderr, "Could not add new block\n");
+        freeBlockchain(blockchain);
+        freeTransactions(unspent);
+        free(mined);
+        free(admitted);
+        exit(EXIT_FAILURE);
+    }
+    printf("Time taken to mine block: %.3f seconds\n", (trace.found - trace.started) / 1e9);
+    if (!distributed && stats.wall_seconds > 0)
+    {
+        printf("Hash rate: %.0f H/s wall, %.0f H/s per CPU second\n", stats.hashes / stats.wall_seconds,
+               stats.cpu_seconds > 0 ? stats.hashes / stats.cpu_seconds : 0.0);
+        printf("Duty cycle: %.0f%% of %d thread%s\n", 100 * stats.cpu_seconds / (stats.wall_seconds * stats.threads),
+               stats.threads, stats.threads == 1 ? "" : "s");
+        /*
+         * Retarget on the CPU time per thread, which is how long the same
+         * threads would take unthrottled, so a throttled miner does not
+         * read as a slow chain. An unthrottled run uses its wall time, so
+         * mining with more threads still reads as a faster chain
+         */
+        endTime = startTime + (uint64_t)(stats.cpu_seconds / stats.threads + 0.5);
+    }
     printf("\n\n");
 
     blockchain->difficulty = adjustDifficulty(startTime, endTime, blockchain->difficulty);
     printf("New Difficulty Level: %d\n", blockchain->difficulty);
 
-    printf("\n------VERIFYING BLOCKCHAIN INTERGRITY-------\n");
-    if (!validateBlockchain(blockchain))
+    /* Earlier blocks were checksummed at load; only the new one needs hashing */
+    printf("\n------VERIFYING NEW BLOCK-------\n");
+    if (!validateBlock(blockchain, blockchain->length - 1))
     {
-        fprintf(stderr, "Blockchain is not valid\n");
+        fprintf(stderr, "New block is not valid\n");
         freeBlockchain(blockchain);
-        freeTransactions(unspent);
+        free(mined);
+        free(admitted);
         exit(EXIT_FAILURE);
     }
 
-    printf("Blockchain is valid\n");
+    trace.validated = latencyNow();
+    printf("New block is valid\n");
 
-    if (!serializeBlockchain(blockchain))
+    trace.writing = latencyNow();
+    if (!serializeBlockchain(&ctx, blockchain))
     {
-        fprintf(stderr, "Blockchain with new block could not be serialized\n");
+        fprintf(stderr, "Blockchain with new block could not be serialized: %s\n", blockchainStrerror(blockchainError()));
         freeBlockchain(blockchain);
-        freeTransactions(unspent);
+        free(mined);
+        free(admitted);
         exit(EXIT_FAILURE);
     }
+    trace.persisted = latencyNow();
+
+    /* Keep an existing columnar export in step with the chain, once the block is persisted */
+    if (stat(ctx.export_path, &st) == 0 && S_ISDIR(st.st_mode) &&
+        exportTransactions(blockchain, ctx.export_path, -1) < 0)
+        fprintf(stderr, "Could not update transaction export\n");
+    freeBlockchain(blockchain);
 
     printf("Serialized new blockchain\n");
+    printf("Validation: %.3f ms, persistence: %.3f ms\n",
+           (trace.validated - trace.found) / 1e6, (trace.persisted - trace.writing) / 1e6);
 
-    unspent = (list_of_transactions *)malloc(sizeof(list_of_transactions));
-    if (!unspent)
+    /* Only drop what was mined; transactions submitted meanwhile stay */
+    lockFd = lockUnspent(&ctx, 1);
+    if (lockFd < 0 || !drainTransactionQueue(&ctx) || !removeFromUnspent(&ctx, mined, nb_mined))
     {
-        fprintf(stderr, "Memory allocation failed for new unspent transactions\n");
-        exit(EXIT_FAILURE);
-    }
-    unspent->head = unspent->tail = NULL;
-    unspent->nb_trans = 0;
-    
-    if (!serializeUnspent(unspent))
-    {
-        fprintf(stderr, "Failed to reset unspent transactions\n");
-        freeTransactions(unspent);
+        fprintf(stderr, "Failed to remove mined transactions from pool: %s\n", blockchainStrerror(blockchainError()));
+        unlockUnspent(&ctx, lockFd);
+        free(mined);
+        free(admitted);
         exit(EXIT_FAILURE);
     }
-    freeTransactions(unspent);
+    /* The pool lock also serializes updates of the latency histograms */
+    if (!traceBlock(&ctx, &trace, admitted, nb_mined))
+        fprintf(stderr, "Could not record block latency: %s\n", blockchainStrerror(blockchainError()));
+    unlockUnspent(&ctx, lockFd);
+    free(mined);
+    free(admitted);
+    closeContext(&ctx);
 
     printf("MINING COMPLETE. NEW BLOCK ADDED TO BLOCKCHAIN\n");
     return 0;
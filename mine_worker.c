@@ -0,0 +1,31 @@
+#include "blockchain.h"
+
+/**
+ * main - mining worker serving a mine_block -d coordinator
+ * @argc: argument count
+ * @argv: -o to exit once the current block is mined instead of waiting
+ * for the next one
+ * Return: 0 on success
+ */
+int main(int argc, char **argv)
+{
+    int once = argc > 1 && strcmp(argv[1], "-o") == 0;
+    blockchain_ctx_t ctx;
+
+    if (!initContext(&ctx, NULL))
+    {
+        fprintf(stderr, "Could not set up blockchain context: %s\n", blockchainStrerror(blockchainError()));
+        exit(EXIT_FAILURE);
+    }
+    ctx.log = stdout;
+
+    printf("Worker waiting for work on %s\n", ctx.socket_path);
+    fflush(stdout);
+    if (!workMining(&ctx, once))
+    {
+        fprintf(stderr, "Worker stopped on error: %s\n", blockchainStrerror(blockchainError()));
+        exit(EXIT_FAILURE);
+    }
+    closeContext(&ctx);
+    return 0;
+}
@@ -0,0 +1,323 @@
+#include "blockchain.h"
+
+/*
+ * The pool keeps its transactions unordered in a list_of_transactions and
+ * indexes them with two binary heaps over their positions: a max-heap on
+ * priority for block assembly and a min-heap for eviction. Each entry
+ * records where it sits in both heaps, so any entry can be removed from
+ * either side in O(log N).
+ *
+ * Priority is the fee, ties going to the oldest admission (lowest index).
+ */
+
+/**
+ * higher - tells whether entry a has priority over entry b
+ * @pool: pointer to pool
+ * @a: position of first entry
+ * @b: position of second entry
+ * Return: 1 if a comes first else 0
+ */
+static int higher(tx_pool_t *pool, int a, int b)
+{
+    transaction_t *ta = &pool->entries->trans[a];
+    transaction_t *tb = &pool->entries->trans[b];
+
+    if (ta->fee != tb->fee)
+        return ta->fee > tb->fee;
+    return (int32_t)((uint32_t)ta->index - (uint32_t)tb->index) < 0;
+}
+
+/**
+ * before - heap order: max-heap puts higher entries on top, min-heap lower
+ * @pool: pointer to pool
+ * @heap: pool->maxHeap or pool->minHeap
+ * @a: position of first entry
+ * @b: position of second entry
+ * Return: 1 if a belongs above b
+ */
+static int before(tx_pool_t *pool, int *heap, int a, int b)
+{
+    return heap == pool->maxHeap ? higher(pool, a, b) : higher(pool, b, a);
+}
+
+static void heapSwap(int *heap, int *pos, int i, int j)
+{
+    int tmp = heap[i];
+    heap[i] = heap[j];
+    heap[j] = tmp;
+    pos[heap[i]] = i;
+    pos[heap[j]] = j;
+}
+
+static void siftUp(tx_pool_t *pool, int *heap, int *pos, int i)
+{
+    while (i > 0 && before(pool, heap, heap[i], heap[(i - 1) / 2]))
+    {
+        heapSwap(heap, pos, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void siftDown(tx_pool_t *pool, int *heap, int *pos, int i)
+{
+    int n = pool->entries->nb_trans;
+
+    for (;;)
+    {
+        int best = i, l = 2 * i + 1, r = l + 1;
+        if (l < n && before(pool, heap, heap[l], heap[best]))
+            best = l;
+        if (r < n && before(pool, heap, heap[r], heap[best]))
+            best = r;
+        if (best == i)
+            return;
+        heapSwap(heap, pos, i, best);
+        i = best;
+    }
+}
+
+/**
+ * reservePool - grows the heap arrays alongside the entries
+ * @pool: pointer to pool
+ * @capacity: minimum number of entries
+ * Return: 1 on success else 0
+ */
+static int reservePool(tx_pool_t *pool, int capacity)
+{
+    int **arrays[4] = {&pool->maxHeap, &pool->minHeap, &pool->maxPos, &pool->minPos};
+    int cap;
+
+    if (!reserveTransactions(pool->entries, capacity))
+        return 0;
+    if (capacity <= pool->capacity)
+        return 1;
+    cap = pool->entries->capacity;
+    for (int i = 0; i < 4; i++)
+    {
+        int *array = realloc(*arrays[i], cap * sizeof(int));
+        if (!array)
+            return blockchainFail(BC_ENOMEM);
+        *arrays[i] = array;
+    }
+    pool->capacity = cap;
+    return 1;
+}
+
+/**
+ * poolRemoveAt - removes an entry from both heaps and the storage
+ * @pool: pointer to pool
+ * @e: position of entry in storage
+ */
+static void poolRemoveAt(tx_pool_t *pool, int e)
+{
+    list_of_transactions *entries = pool->entries;
+    int last = entries->nb_trans - 1;
+    int *heaps[2] = {pool->maxHeap, pool->minHeap};
+    int *pos[2] = {pool->maxPos, pool->minPos};
+
+    /* Drop e from each heap, refilling its spot with the heap's last item */
+    for (int h = 0; h < 2; h++)
+    {
+        int i = pos[h][e];
+        heapSwap(heaps[h], pos[h], i, last);
+        entries->nb_trans--;
+        if (i < last)
+        {
+            int moved = heaps[h][i];
+            siftUp(pool, heaps[h], pos[h], i);
+            siftDown(pool, heaps[h], pos[h], pos[h][moved]);
+        }
+        entries->nb_trans++;
+    }
+
+    /* Move the last stored entry into e's slot */
+    if (e != last)
+    {
+        entries->trans[e] = entries->trans[last];
+        entries->payloads[e] = entries->payloads[last];
+        for (int h = 0; h < 2; h++)
+        {
+            pos[h][e] = pos[h][last];
+            heaps[h][pos[h][e]] = e;
+        }
+    }
+    entries->nb_trans--;
+}
+
+/**
+ * poolCapacity - tells how many transactions a pool holds before evicting
+ * @ctx: pointer to context holding the pool limits
+ * Return: the entry cap, lowered to what fits in the memory cap, at least 1
+ */
+int poolCapacity(const blockchain_ctx_t *ctx)
+{
+    size_t fit = ctx->pool_max_bytes / (sizeof(transaction_t) + sizeof(transaction_payload_t));
+
+    if (fit < 1)
+        fit = 1;  /* poolAdmit evicts from a non-empty pool only */
+    return (size_t)ctx->pool_max_entries > fit ? (int)fit : ctx->pool_max_entries;
+}
+
+/**
+ * loadPool - reads the pool file and indexes it
+ * @ctx: pointer to context, kept by the pool for savePool
+ * Return: pointer to pool (empty if the file is missing) or NULL on failure,
+ * which includes a pool file that cannot be read: it must not be replaced
+ */
+tx_pool_t *loadPool(blockchain_ctx_t *ctx)
+{
+    tx_pool_t *pool = calloc(1, sizeof(*pool));
+    int n;
+
+    if (!pool)
+    {
+        blockchainFail(BC_ENOMEM);
+        return NULL;
+    }
+    pool->ctx = ctx;
+    pool->max_entries = poolCapacity(ctx);
+
+    pool->entries = deserializeUnspent(ctx, &pool->next_index);
+    n = pool->entries ? pool->entries->nb_trans : 0;
+    if (!pool->entries || !reservePool(pool, n > 0 ? n : 1))
+    {
+        freePool(pool);
+        return NULL;
+    }
+
+    /* Floyd heap construction, O(N) */
+    for (int i = 0; i < n; i++)
+    {
+        pool->maxHeap[i] = pool->minHeap[i] = i;
+        pool->maxPos[i] = pool->minPos[i] = i;
+    }
+    for (int i = n / 2 - 1; i >= 0; i--)
+    {
+        siftDown(pool, pool->maxHeap, pool->maxPos, i);
+        siftDown(pool, pool->minHeap, pool->minPos, i);
+    }
+    return pool;
+}
+
+/**
+ * savePool - writes the pool file
+ * @pool: pointer to pool
+ * Return: 1 on success else 0
+ */
+int savePool(tx_pool_t *pool)
+{
+    return serializeUnspent(pool->ctx, pool->entries, pool->next_index);
+}
+
+/**
+ * freePool - frees a pool
+ * @pool: pointer to pool
+ */
+void freePool(tx_pool_t *pool)
+{
+    if (!pool)
+        return;
+    freeTransactions(pool->entries);
+    free(pool->maxHeap);
+    free(pool->minHeap);
+    free(pool->maxPos);
+    free(pool->minPos);
+    free(pool);
+}
+
+/**
+ * poolAdmit - admits a transaction, evicting the lowest priority entry
+ * when the pool is full
+ * @pool: pointer to pool
+ * @sender: sender details
+ * @receiver: receiver details
+ * @amount: amount of transaction
+ * @fee: priority of transaction, higher is mined first
+ * @admitted: submission time from latencyNow(), 0 if unknown
+ * Return: 1 if admitted, 0 if rejected because every entry of a full pool
+ * outranks it, -1 on allocation failure
+ */
+int poolAdmit(tx_pool_t *pool, const char *sender, const char *receiver, const char *amount, uint64_t fee, uint64_t admitted)
+{
+    list_of_transactions *entries = pool->entries;
+    int e;
+
+    if (entries->nb_trans >= pool->max_entries)
+    {
+        int lowest = pool->minHeap[0];
+        transaction_t *low = &entries->trans[lowest];
+        if (fee <= low->fee)
+            return 0;
+        poolRemoveAt(pool, lowest);
+    }
+
+    if (!reservePool(pool, entries->nb_trans + 1) ||
+        !appendTransaction(entries, sender, receiver, amount, fee))
+        return -1;
+    e = entries->nb_trans - 1;
+    entries->trans[e].index = pool->next_index;
+    entries->payloads[e].admitted = admitted;
+    pool->next_index = (int32_t)((uint32_t)pool->next_index + 1);
+    pool->maxHeap[e] = pool->minHeap[e] = e;
+    pool->maxPos[e] = pool->minPos[e] = e;
+    siftUp(pool, pool->maxHeap, pool->maxPos, e);
+    siftUp(pool, pool->minHeap, pool->minPos, e);
+    return 1;
+}
+
+/**
+ * poolTakeTop - pops the k highest priority transactions, O(k log N)
+ * @pool: pointer to pool
+ * @k: maximum number of transactions to take
+ * Return: new list ordered by priority, each keeping its pool index, or
+ * NULL on failure
+ */
+list_of_transactions *poolTakeTop(tx_pool_t *pool, int k)
+{
+    list_of_transactions *top;
+
+    if (k > pool->entries->nb_trans)
+        k = pool->entries->nb_trans;
+    top = newTransactions(k);
+    if (!top)
+        return NULL;
+    for (int i = 0; i < k; i++)
+    {
+        int e = pool->maxHeap[0];
+        top->trans[i] = pool->entries->trans[e];
+        top->payloads[i] = pool->entries->payloads[e];
+        top->nb_trans++;
+        poolRemoveAt(pool, e);
+    }
+    return top;
+}
+
+static int compareIndex(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * poolRemoveIndices - removes the entries with the given pool indices
+ * @pool: pointer to pool
+ * @indices: pool indices to remove, sorted in place
+ * @count: number of indices
+ * Return: number of entries removed
+ */
+int poolRemoveIndices(tx_pool_t *pool, int *indices, int count)
+{
+    int removed = 0;
+
+    qsort(indices, count, sizeof(*indices), compareIndex);
+    for (int e = pool->entries->nb_trans - 1; e >= 0; e--)
+    {
+        int index = pool->entries->trans[e].index;
+        if (bsearch(&index, indices, count, sizeof(*indices), compareIndex))
+        {
+            poolRemoveAt(pool, e);
+            removed++;
+        }
+    }
+    return removed;
+}
@@ -2,22 +2,44 @@
 
 /**
  * main - prints blockchain
+ * @argc: argument count
+ * @argv: --audit also recomputes every block hash
  * Return: 0 always
  */
-int main(void)
+int main(int argc, char **argv)
 {
-    Blockchain *blockchain = deserializeBlockchain();
+    int audit = argc > 1 && strcmp(argv[1], "--audit") == 0;
+    blockchain_ctx_t ctx;
+
+    if (!initContext(&ctx, NULL))
+    {
+        fprintf(stderr, "Could not set up blockchain context: %s\n", blockchainStrerror(blockchainError()));
+        exit(EXIT_FAILURE);
+    }
+    ctx.log = stdout;
+    ctx.salvage = 1;  /* read only: show what is left of a damaged chain */
+
+    Blockchain *blockchain = deserializeBlockchain(&ctx);
+    closeContext(&ctx);
     if (!blockchain)
     {
-        fprintf(stderr, "Could not get blockchain from file\n");
+        fprintf(stderr, "Could not get blockchain from file: %s\n", blockchainStrerror(blockchainError()));
         exit(EXIT_FAILURE);
     }
-    if (!blockchain->head)
+    if (blockchain->length == 0)
     {
         printf("Blockchain is empty\n");
+        freeBlockchain(blockchain);
         return 0;
     }
     printBlockchain(blockchain);
+    if (audit)
+    {
+        int valid = validateBlockchain(blockchain);
+        printf("Audit: blockchain is %s\n", valid ? "valid" : "NOT valid");
+        freeBlockchain(blockchain);
+        return valid ? 0 : EXIT_FAILURE;
+    }
     freeBlockchain(blockchain);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,433 @@
+#include "blockchain.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+_Static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "queue needs lock-free 64-bit atomics to be shared between processes");
+
+/*
+ * Bounded multi-producer/single-consumer ring living in shared memory.
+ *
+ * Each slot carries a sequence number telling whose turn it is: producers
+ * may fill slot i at position pos when seq == pos, the consumer may read it
+ * once seq == pos + 1, and releases it for the next lap with
+ * seq = pos + QUEUE_SLOTS. Sequences are stored relative to the slot index
+ * so a freshly created, zero-filled segment is already a valid empty ring
+ * and no process has to initialize it.
+ *
+ * The single consumer is whoever holds the pool lock (TRANSACTION_LOCK).
+ * Each context maps the ring once, in initContext.
+ *
+ * A producer killed between claiming a slot and publishing it would block
+ * the consumer at that slot forever. Producers therefore record their pid
+ * in the slot they claim. When the slot at the tail is claimed but
+ * unpublished and its claimer no longer exists, the consumer releases it
+ * to the next lap and moves on. When the claimer cannot be shown dead
+ * (unknown, or alive but stalled for QUEUE_STALL_SECONDS) the consumer
+ * moves on but retires the slot instead: the next lap's producers see it
+ * as full and take the locked path. Producers publish with a
+ * compare-and-swap, so a stalled one that resumes finds its slot retired,
+ * hands it back to the next lap itself and takes the locked path too. No
+ * transaction is lost, and no payload is ever written by two producers.
+ * Processes sharing a ring must share a pid namespace.
+ *
+ * The consumer notes in rejected[] each position a full pool turned away,
+ * so producers can tell their submitter whether the transaction made it.
+ */
+typedef struct queue_slot_s {
+    _Atomic uint64_t sequence;
+    _Atomic int32_t claimer;  /* pid of the producer filling the slot, 0 if unknown */
+    transaction_payload_t payload;
+    char amount[20];
+    uint64_t fee;
+} queue_slot_t;
+
+typedef struct tx_queue_s {
+    _Atomic uint64_t head;  /* next position producers claim */
+    char pad[64 - sizeof(uint64_t)];
+    _Atomic uint64_t tail;  /* next position the consumer reads */
+    queue_slot_t slots[QUEUE_SLOTS];
+    uint64_t stalled_pos;    /* consumer only: tail position seen unpublished */
+    uint64_t stalled_since;  /* consumer only: when, CLOCK_MONOTONIC seconds, 0 if none */
+    _Atomic uint64_t rejected[QUEUE_SLOTS];  /* per slot: last position turned away, plus one */
+} tx_queue_t;
+
+/**
+ * queueName - names the shared ring of a blockchain directory
+ * @dir: directory holding the pool file
+ * @name: buffer of 64 bytes
+ * Return: 1 on success else 0 if the directory does not exist
+ */
+static int queueName(const char *dir, char *name)
+{
+    char path[PATH_MAX];
+    uint64_t h = 14695981039346656037ULL;
+
+    if (!realpath(dir, path))
+        return 0;
+    /*
+     * One ring per pool file, whatever path the directory is reached by;
+     * the format version keeps builds with another slot layout apart
+     */
+    for (char *c = path; *c; c++)
+        h = (h ^ (unsigned char)*c) * 1099511628211ULL;
+    snprintf(name, 64, "%s_v%d_%016" PRIx64, TRANSACTION_QUEUE, DATABASE_VERSION, h);
+    return 1;
+}
+
+/**
+ * openTransactionQueue - maps the shared ring of a blockchain directory,
+ * creating it on first use
+ * @ctx: pointer to context, its directory set
+ * Return: pointer to ring or NULL when shared memory is unavailable
+ */
+void *openTransactionQueue(const blockchain_ctx_t *ctx)
+{
+    char name[64];
+    struct stat st;
+    int fd;
+    void *mem;
+
+    if (!queueName(ctx->dir, name))
+        return NULL;
+    fd = shm_open(name, O_RDWR | O_CREAT, 0666);
+    if (fd < 0)
+        return NULL;
+    /* Concurrent creators all extend to the same size, which is harmless */
+    if (fstat(fd, &st) != 0 ||
+        ((size_t)st.st_size < sizeof(tx_queue_t) && ftruncate(fd, sizeof(tx_queue_t)) != 0))
+    {
+        close(fd);
+        return NULL;
+    }
+    mem = mmap(NULL, sizeof(tx_queue_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+        return NULL;
+    return mem;
+}
+
+/**
+ * closeTransactionQueue - unmaps a ring
+ * @queue: ring from openTransactionQueue, or NULL
+ */
+void closeTransactionQueue(void *queue)
+{
+    if (queue)
+        munmap(queue, sizeof(tx_queue_t));
+}
+
+/**
+ * removeTransactionQueue - removes the shared ring of a blockchain
+ * directory, so the next process to open it starts with a fresh one
+ * @ctx: pointer to context
+ *
+ * Processes that still have the ring mapped keep using it until they close
+ * it. Call with the pool lock held, after draining.
+ * Return: 1 on success or if there was no ring, else 0
+ */
+int removeTransactionQueue(const blockchain_ctx_t *ctx)
+{
+    char name[64];
+
+    if (!queueName(ctx->dir, name))
+        return blockchainFail(BC_EINVAL);
+    return shm_unlink(name) == 0 || errno == ENOENT || blockchainFail(BC_EIO);
+}
+
+/**
+ * enqueueTransaction - pushes a transaction into the shared ring without
+ * taking any lock
+ * @ctx: pointer to context
+ * @sender: sender details
+ * @receiver: receiver details
+ * @amount: amount of transaction
+ * @fee: transaction fee
+ * @position: pointer to address to store the ring position, for queueOutcome
+ * Return: 1 if queued, 0 if the ring is full or unavailable
+ */
+int enqueueTransaction(blockchain_ctx_t *ctx, const char *sender, const char *receiver, const char *amount, uint64_t fee, uint64_t *position)
+{
+    tx_queue_t *q = ctx->queue;
+    queue_slot_t *slot;
+    uint64_t pos, idx;
+
+    if (!q)
+        return 0;
+
+    pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    for (;;)
+    {
+        idx = pos & (QUEUE_SLOTS - 1);
+        slot = &q->slots[idx];
+        int64_t diff = (int64_t)(atomic_load_explicit(&slot->sequence, memory_order_acquire) + idx - pos);
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                atomic_store_explicit(&slot->claimer, (int32_t)getpid(), memory_order_relaxed);
+                break;
+            }
+        }
+        else if (diff < 0)
+            return 0;  /* full */
+        else
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    }
+
+    /* strncpy zero-pads, keeping the hashed buffers deterministic */
+    strncpy(slot->payload.sender, sender, DATASIZE_MAX - 1);
+    slot->payload.sender[DATASIZE_MAX - 1] = '\0';
+    strncpy(slot->payload.receiver, receiver, DATASIZE_MAX - 1);
+    slot->payload.receiver[DATASIZE_MAX - 1] = '\0';
+    strncpy(slot->amount, amount, sizeof(slot->amount) - 1);
+    slot->amount[sizeof(slot->amount) - 1] = '\0';
+    slot->fee = fee;
+    slot->payload.admitted = latencyNow();
+    *position = pos;
+    /* Fails only if the consumer retired this slot, see the top comment */
+    uint64_t claimed = pos - idx;
+    if (atomic_compare_exchange_strong_explicit(&slot->sequence, &claimed, pos + 1 - idx,
+                                                memory_order_release, memory_order_relaxed))
+        return 1;
+    atomic_store_explicit(&slot->claimer, 0, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, pos + QUEUE_SLOTS - idx, memory_order_release);
+    return 0;
+}
+
+/**
+ * queueOutcome - tells what the pool made of a queued transaction
+ * @ctx: pointer to context
+ * @position: ring position from enqueueTransaction
+ *
+ * The answer is taken from the slot's note, so it is only reliable until
+ * QUEUE_SLOTS later submissions have been drained; ask right after a flush.
+ * Return: 1 if admitted, 0 if a full pool turned it away, -1 if it has not
+ * been drained yet
+ */
+int queueOutcome(blockchain_ctx_t *ctx, uint64_t position)
+{
+    tx_queue_t *q = ctx->queue;
+
+    if (atomic_load_explicit(&q->tail, memory_order_acquire) <= position)
+        return -1;
+    return atomic_load_explicit(&q->rejected[position & (QUEUE_SLOTS - 1)], memory_order_relaxed) != position + 1;
+}
+
+/**
+ * queuePending - tells whether published transactions await draining
+ * @ctx: pointer to context
+ * Return: 1 if the next slot is ready to be drained else 0
+ */
+static int queuePending(blockchain_ctx_t *ctx)
+{
+    tx_queue_t *q = ctx->queue;
+    uint64_t pos, idx;
+
+    if (!q)
+        return 0;
+    pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    idx = pos & (QUEUE_SLOTS - 1);
+    return atomic_load_explicit(&q->slots[idx].sequence, memory_order_acquire) + idx == pos + 1;
+}
+
+/**
+ * skipStalled - moves the tail past a slot that is claimed but unpublished,
+ * releasing it if its claimer is dead, or retiring it once it has stalled
+ * for QUEUE_STALL_SECONDS; caller must hold the pool lock
+ * @ctx: pointer to context
+ * @q: pointer to ring
+ * Return: 1 if the slot was skipped else 0
+ */
+static int skipStalled(blockchain_ctx_t *ctx, tx_queue_t *q)
+{
+    uint64_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    uint64_t idx = pos & (QUEUE_SLOTS - 1), claimed = pos - idx, now, next;
+    queue_slot_t *slot = &q->slots[idx];
+    struct timespec ts;
+    int32_t claimer;
+    int dead;
+
+    /* Claimed means a producer moved head past the slot without publishing it */
+    if (atomic_load_explicit(&q->head, memory_order_relaxed) == pos ||
+        atomic_load_explicit(&slot->sequence, memory_order_acquire) != claimed)
+    {
+        q->stalled_since = 0;
+        return 0;
+    }
+    claimer = atomic_load_explicit(&slot->claimer, memory_order_relaxed);
+    dead = claimer > 0 && kill(claimer, 0) != 0 && errno == ESRCH;
+    if (dead)
+    {
+        /* Nobody can write the slot any more: the next lap may have it */
+        atomic_store_explicit(&slot->claimer, 0, memory_order_relaxed);
+        next = pos + QUEUE_SLOTS - idx;
+    }
+    else
+    {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        now = (uint64_t)ts.tv_sec + 1;
+        if (!q->stalled_since || q->stalled_pos != pos)
+        {
+            q->stalled_pos = pos;
+            q->stalled_since = now;
+            return 0;
+        }
+        if (now - q->stalled_since < QUEUE_STALL_SECONDS)
+            return 0;
+        /* Its producer may still write it: retired until it hands it back */
+        next = pos + 2 - idx;
+    }
+    if (!atomic_compare_exchange_strong_explicit(&slot->sequence, &claimed, next,
+                                                 memory_order_acq_rel, memory_order_acquire))
+        return 0;
+    atomic_store_explicit(&q->tail, pos + 1, memory_order_relaxed);
+    q->stalled_since = 0;
+    if (dead)
+        logContext(ctx, "Skipped queue slot %" PRIu64 ", claimed by process %d that died before publishing it\n",
+                   pos, (int)claimer);
+    else
+        logContext(ctx, "Retired queue slot %" PRIu64 ", claimed by a producer that has not published it for %d seconds\n",
+                   pos, QUEUE_STALL_SECONDS);
+    return 1;
+}
+
+/**
+ * drainTransactionQueue - moves every published transaction from the ring
+ * to the pool file in one batch; caller must hold the pool lock
+ * @ctx: pointer to context
+ *
+ * Slots are only released after the pool has been written, so a crash
+ * mid-drain leaves the transactions in the ring rather than losing them.
+ * Transactions a full pool turns away are consumed all the same, and noted
+ * for queueOutcome. A slot
+ * whose producer died before publishing it is skipped, see skipStalled.
+ * Return: 1 on success else 0
+ */
+int drainTransactionQueue(blockchain_ctx_t *ctx)
+{
+    tx_queue_t *q = ctx->queue;
+    tx_pool_t *pool;
+    uint64_t start, pos, idx;
+
+    if (!q)
+        return 1;
+    while (skipStalled(ctx, q))
+        ;
+    if (!queuePending(ctx))
+        return 1;
+
+    pool = loadPool(ctx);
+    if (!pool)
+        return 0;
+
+    start = pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    for (;; pos++)
+    {
+        idx = pos & (QUEUE_SLOTS - 1);
+        queue_slot_t *slot = &q->slots[idx];
+        if (atomic_load_explicit(&slot->sequence, memory_order_acquire) + idx != pos + 1)
+            break;
+        int admitted = poolAdmit(pool, slot->payload.sender, slot->payload.receiver, slot->amount, slot->fee, slot->payload.admitted);
+        if (admitted < 0)
+            break;
+        /*
+         * Set or clear the note on every pass: a drain whose save failed may
+         * have noted this position, and the pass that releases it decides
+         */
+        atomic_store_explicit(&q->rejected[idx], admitted ? 0 : pos + 1, memory_order_relaxed);
+    }
+
+    if (pos == start || !savePool(pool))
+    {
+        freePool(pool);
+        return 0;
+    }
+    freePool(pool);
+
+    for (uint64_t p = start; p < pos; p++)
+    {
+        idx = p & (QUEUE_SLOTS - 1);
+        atomic_store_explicit(&q->slots[idx].claimer, 0, memory_order_relaxed);
+        atomic_store_explicit(&q->slots[idx].sequence, p + QUEUE_SLOTS - idx, memory_order_release);
+    }
+    /* Release: whoever sees the new tail also sees the rejected[] notes */
+    atomic_store_explicit(&q->tail, pos, memory_order_release);
+    return 1;
+}
+
+/**
+ * lockUnspent - takes the exclusive pool lock
+ * @ctx: pointer to context
+ * @wait: 1 to block until the lock is free, 0 to give up if it is held
+ * Return: lock descriptor, or -1 if the lock could not be taken
+ */
+int lockUnspent(blockchain_ctx_t *ctx, int wait)
+{
+    /* flock locks the open file, so threads of one process exclude each other too */
+    int fd = open(ctx->lock_path, O_RDWR | O_CREAT, 0666);
+    if (fd < 0)
+    {
+        blockchainFail(BC_EIO);
+        return -1;
+    }
+    if (flock(fd, LOCK_EX | (wait ? 0 : LOCK_NB)) != 0)
+    {
+        close(fd);
+        blockchainFail(BC_EIO);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * flushTransactionQueue - drains the ring if no other process is doing so
+ *
+ * Whoever holds the lock re-checks the ring after releasing it, so a
+ * transaction published while another process drained is never stranded.
+ * A slot still being filled stops the flush: its producer flushes next.
+ * @ctx: pointer to context
+ * Return: 1 on success else 0
+ */
+int flushTransactionQueue(blockchain_ctx_t *ctx)
+{
+    tx_queue_t *q = ctx->queue;
+
+    while (q && atomic_load_explicit(&q->head, memory_order_relaxed) != atomic_load_explicit(&q->tail, memory_order_relaxed))
+    {
+        uint64_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        int ok, fd = lockUnspent(ctx, 0);
+        if (fd < 0)
+            return 1;  /* the holder drains it */
+        ok = drainTransactionQueue(ctx);
+        flock(fd, LOCK_UN);
+        close(fd);
+        if (!ok)
+            return 0;
+        if (atomic_load_explicit(&q->tail, memory_order_relaxed) == tail)
+            return 1;
+    }
+    return 1;
+}
+
+/**
+ * unlockUnspent - releases the pool lock, then drains anything producers
+ * queued while it was held
+ * @ctx: pointer to context
+ * @fd: lock descriptor from lockUnspent
+ */
+void unlockUnspent(blockchain_ctx_t *ctx, int fd)
+{
+    if (fd < 0)
+        return;
+    flock(fd, LOCK_UN);
+    close(fd);
+    flushTransactionQueue(ctx);
+}
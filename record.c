@@ -0,0 +1,417 @@
+#include "blockchain.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+/*
+ * Database files start with a file_header_t, followed by records framed as
+ *   uint32 length | uint32 crc32c(payload) | uint32 crc32c(length, crc) | payload
+ * so a load can detect truncation and bit-rot without re-hashing blocks.
+ * The frame has a checksum of its own, so a damaged length is reported as
+ * corruption before anything is allocated or read for it.
+ */
+
+/**
+ * reserveRecord - grows a record buffer
+ * @record: pointer to record buffer
+ * @len: minimum capacity in bytes
+ * Return: 1 on success else 0
+ */
+int reserveRecord(record_t *record, size_t len)
+{
+    unsigned char *data;
+    size_t cap;
+
+    if (len <= record->cap)
+        return 1;
+    cap = record->cap ? record->cap : 4096;
+    while (cap < len)
+        cap *= 2;
+    data = realloc(record->data, cap);
+    if (!data)
+        return blockchainFail(BC_ENOMEM);
+    record->data = data;
+    record->cap = cap;
+    return 1;
+}
+
+/**
+ * freeRecord - releases a record buffer
+ * @record: pointer to record buffer
+ */
+void freeRecord(record_t *record)
+{
+    free(record->data);
+    memset(record, 0, sizeof(*record));
+}
+
+/**
+ * directoryOf - copies the directory part of a path
+ * @path: file path
+ * @dir: buffer of SNAPSHOT_PATH_MAX bytes
+ * Return: 1 on success else 0 if the directory is too long
+ */
+static int directoryOf(const char *path, char *dir)
+{
+    const char *slash = strrchr(path, '/');
+
+    if (!slash)
+        strcpy(dir, ".");
+    else if (slash == path)
+        strcpy(dir, "/");
+    else if ((size_t)(slash - path) < SNAPSHOT_PATH_MAX)
+    {
+        memcpy(dir, path, slash - path);
+        dir[slash - path] = '\0';
+    }
+    else
+        return 0;
+    return 1;
+}
+
+/**
+ * removeStaleSnapshots - deletes the temporary files of path left behind by
+ * writers that died before committing them
+ * @path: database file about to be rewritten
+ *
+ * Only files named by beginSnapshot whose process no longer exists are
+ * removed, so snapshots still being written are left alone.
+ */
+static void removeStaleSnapshots(const char *path)
+{
+    char dir[SNAPSHOT_PATH_MAX];
+    const char *slash = strrchr(path, '/');
+    const char *base = slash ? slash + 1 : path;
+    size_t len = strlen(base);
+    struct dirent *entry;
+    DIR *d;
+
+    if (!directoryOf(path, dir) || !(d = opendir(dir)))
+        return;
+    while ((entry = readdir(d)))
+    {
+        long pid;
+        unsigned int n;
+        int end = 0;
+
+        if (strncmp(entry->d_name, base, len) != 0 || entry->d_name[len] != '.' ||
+            sscanf(entry->d_name + len, ".%ld.%u.tmp%n", &pid, &n, &end) != 2 ||
+            entry->d_name[len + end] != '\0' || end == 0 || pid <= 0 || pid == (long)getpid())
+            continue;
+        if (kill((pid_t)pid, 0) != 0 && errno == ESRCH)
+            unlinkat(dirfd(d), entry->d_name, 0);
+    }
+    closedir(d);
+}
+
+/**
+ * beginSnapshot - opens a temporary file to rewrite a database file into
+ * @snapshot: pointer to snapshot to fill
+ * @path: database file to replace
+ *
+ * Readers keep opening path and see the previous version untouched until
+ * commitSnapshot renames the new one over it, so they never take a lock
+ * nor observe a truncated file. The temporary name carries the process id
+ * and a per-process sequence number, so threads and processes rewriting
+ * the same file never share one. Temporary files of writers that crashed
+ * are removed first.
+ * Return: file to write to or NULL on failure
+ */
+FILE *beginSnapshot(snapshot_t *snapshot, const char *path)
+{
+    static _Atomic unsigned int sequence;
+    unsigned int n = atomic_fetch_add(&sequence, 1);
+
+    snapshot->path = path;
+    if ((size_t)snprintf(snapshot->tmp, sizeof(snapshot->tmp), "%s.%ld.%u.tmp", path, (long)getpid(), n) >= sizeof(snapshot->tmp))
+    {
+        blockchainFail(BC_EINVAL);
+        return NULL;
+    }
+    removeStaleSnapshots(path);
+    snapshot->file = fopen(snapshot->tmp, "wb");
+    if (!snapshot->file)
+        blockchainFail(BC_EIO);
+    return snapshot->file;
+}
+
+/**
+ * syncDirectory - makes a rename in the directory of path durable
+ * @path: file whose directory to sync
+ * Return: 1 on success else 0
+ */
+static int syncDirectory(const char *path)
+{
+    char dir[SNAPSHOT_PATH_MAX];
+    int fd, ok;
+
+    if (!directoryOf(path, dir))
+        return 0;
+    fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+        return 0;
+    ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+/**
+ * commitSnapshot - publishes a snapshot: flushes it to disk, renames it over
+ * the database file and syncs the directory, or discards it
+ * @snapshot: pointer to snapshot from beginSnapshot
+ * @ok: 0 if writing failed and the snapshot must be discarded
+ * Return: 1 if published else 0
+ */
+int commitSnapshot(snapshot_t *snapshot, int ok)
+{
+    int flushed = ok && fflush(snapshot->file) == 0 && fsync(fileno(snapshot->file)) == 0;
+
+    if (fclose(snapshot->file) != 0)
+        flushed = 0;
+    snapshot->file = NULL;
+    if (!flushed || rename(snapshot->tmp, snapshot->path) != 0)
+    {
+        unlink(snapshot->tmp);
+        /* A failed write has already recorded its error */
+        return ok ? blockchainFail(BC_EIO) : 0;
+    }
+    return syncDirectory(snapshot->path) || blockchainFail(BC_EIO);
+}
+
+/**
+ * writeFileHeader - writes the header of a database file
+ * @file: file to write to
+ * @magic: BLOCKCHAIN_MAGIC or TRANSACTION_MAGIC
+ * @value: file specific value (difficulty for the blockchain)
+ * Return: 1 on success else 0
+ */
+int writeFileHeader(FILE *file, uint32_t magic, int32_t value)
+{
+    file_header_t header;
+
+    header.magic = magic;
+    header.version = DATABASE_VERSION;
+    header.value = value;
+    header.crc = crc32c(0, &header, offsetof(file_header_t, crc));
+    return fwrite(&header, sizeof(header), 1, file) == 1 || blockchainFail(BC_EIO);
+}
+
+/**
+ * readFileHeader - reads and checks the header of a database file
+ * @file: file to read from
+ * @magic: expected magic
+ * @value: pointer to address to store file specific value
+ * Return: RECORD_OK, RECORD_END if the file is empty, RECORD_FORMAT if it
+ * is not a file of this type and version, else RECORD_TRUNCATED or
+ * RECORD_CORRUPT
+ */
+int readFileHeader(FILE *file, uint32_t magic, int32_t *value)
+{
+    file_header_t header;
+    size_t n = fread(&header, 1, sizeof(header), file);
+
+    if (n == 0)
+        return RECORD_END;
+    if (n != sizeof(header))
+        return RECORD_TRUNCATED;
+    if (header.crc != crc32c(0, &header, offsetof(file_header_t, crc)))
+        return RECORD_CORRUPT;
+    if (header.magic != magic || header.version != DATABASE_VERSION)
+        return RECORD_FORMAT;
+    *value = header.value;
+    return RECORD_OK;
+}
+
+/**
+ * writeRecord - writes a framed record
+ * @file: file to write to
+ * @record: pointer to record holding the payload
+ * Return: 1 on success else 0
+ */
+int writeRecord(FILE *file, const record_t *record)
+{
+    uint32_t frame[3];
+
+    frame[0] = (uint32_t)record->len;
+    frame[1] = crc32c(0, record->data, record->len);
+    frame[2] = crc32c(0, frame, 2 * sizeof(frame[0]));
+    return (fwrite(frame, sizeof(frame), 1, file) == 1 &&
+            fwrite(record->data, 1, record->len, file) == record->len) || blockchainFail(BC_EIO);
+}
+
+/**
+ * readRecord - reads a framed record and checks its CRC
+ * @file: file to read from
+ * @record: pointer to record buffer receiving the payload
+ * Return: RECORD_OK, RECORD_END at a clean end of file, else
+ * RECORD_TRUNCATED or RECORD_CORRUPT
+ */
+int readRecord(FILE *file, record_t *record)
+{
+    uint32_t frame[3];
+    size_t n = fread(frame, 1, sizeof(frame), file);
+
+    if (n == 0)
+        return RECORD_END;
+    if (n != sizeof(frame))
+        return RECORD_TRUNCATED;
+    if (frame[2] != crc32c(0, frame, 2 * sizeof(frame[0])) || frame[0] > RECORD_MAX)
+        return RECORD_CORRUPT;
+    if (!reserveRecord(record, frame[0]))
+        return RECORD_CORRUPT;
+    if (fread(record->data, 1, frame[0], file) != frame[0])
+        return RECORD_TRUNCATED;
+    record->len = frame[0];
+    if (crc32c(0, record->data, record->len) != frame[1])
+        return RECORD_CORRUPT;
+    return RECORD_OK;
+}
+
+/**
+ * recordError - describes a record status
+ * @status: status returned by readRecord or readFileHeader
+ * Return: static string
+ */
+const char *recordError(int status)
+{
+    return status == RECORD_TRUNCATED ? "truncated record" :
+           status == RECORD_CORRUPT ? "checksum mismatch" :
+           status == RECORD_FORMAT ? "unknown file type or format version" : "ok";
+}
+
+/**
+ * encodeTransaction - appends transaction i of a list to a record
+ * @record: pointer to record buffer
+ * @transactions: pointer to list of transactions
+ * @i: position of transaction in list
+ * Return: 1 on success else 0
+ */
+int encodeTransaction(record_t *record, list_of_transactions *transactions, int i)
+{
+    transaction_t *trans = &transactions->trans[i];
+    transaction_payload_t *payload = &transactions->payloads[i];
+    unsigned char *p;
+
+    if (!reserveRecord(record, record->len + TRANSACTION_RECORD_SIZE))
+        return 0;
+    p = record->data + record->len;
+    memcpy(p, &trans->fee, sizeof(trans->fee));
+    p += sizeof(trans->fee);
+    memcpy(p, &trans->index, sizeof(trans->index));
+    p += sizeof(trans->index);
+    memcpy(p, payload->sender, sizeof(payload->sender));
+    p += sizeof(payload->sender);
+    memcpy(p, payload->receiver, sizeof(payload->receiver));
+    p += sizeof(payload->receiver);
+    memcpy(p, trans->amount, sizeof(trans->amount));
+    p += sizeof(trans->amount);
+    memcpy(p, &payload->admitted, sizeof(payload->admitted));
+    record->len += TRANSACTION_RECORD_SIZE;
+    return 1;
+}
+
+/**
+ * decodeTransaction - appends a transaction encoded at data to a list
+ * @data: TRANSACTION_RECORD_SIZE bytes written by encodeTransaction
+ * @transactions: pointer to list of transactions
+ * Return: 1 on success else 0
+ */
+int decodeTransaction(const unsigned char *data, list_of_transactions *transactions)
+{
+    transaction_t *trans;
+    transaction_payload_t *payload;
+
+    if (!reserveTransactions(transactions, transactions->nb_trans + 1))
+        return 0;
+    trans = &transactions->trans[transactions->nb_trans];
+    payload = &transactions->payloads[transactions->nb_trans];
+    memcpy(&trans->fee, data, sizeof(trans->fee));
+    data += sizeof(trans->fee);
+    memcpy(&trans->index, data, sizeof(trans->index));
+    data += sizeof(trans->index);
+    memcpy(payload->sender, data, sizeof(payload->sender));
+    data += sizeof(payload->sender);
+    memcpy(payload->receiver, data, sizeof(payload->receiver));
+    data += sizeof(payload->receiver);
+    memcpy(trans->amount, data, sizeof(trans->amount));
+    data += sizeof(trans->amount);
+    memcpy(&payload->admitted, data, sizeof(payload->admitted));
+    transactions->nb_trans++;
+    return 1;
+}
+
+/**
+ * encodeBlock - encodes a block and its transactions as a record payload
+ * @record: pointer to record buffer, overwritten
+ * @block: pointer to block
+ * Return: 1 on success else 0
+ */
+int encodeBlock(record_t *record, block_t *block)
+{
+    int nb_trans = block->transactions ? block->transactions->nb_trans : 0;
+    unsigned char *p;
+
+    record->len = 0;
+    if (!reserveRecord(record, BLOCK_RECORD_HEADER_SIZE))
+        return 0;
+    p = record->data;
+    memcpy(p, &block->index, sizeof(block->index));
+    p += sizeof(block->index);
+    memcpy(p, &block->timestamp, sizeof(block->timestamp));
+    p += sizeof(block->timestamp);
+    memcpy(p, &block->nonce, sizeof(block->nonce));
+    p += sizeof(block->nonce);
+    memcpy(p, block->prevHash, SHA256_DIGEST_LENGTH);
+    p += SHA256_DIGEST_LENGTH;
+    memcpy(p, block->currHash, SHA256_DIGEST_LENGTH);
+    p += SHA256_DIGEST_LENGTH;
+    memcpy(p, &nb_trans, sizeof(nb_trans));
+    record->len = BLOCK_RECORD_HEADER_SIZE;
+
+    for (int i = 0; i < nb_trans; i++)
+    {
+        if (!encodeTransaction(record, block->transactions, i))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * decodeBlock - decodes a record payload written by encodeBlock
+ * @record: pointer to record
+ * @block: pointer to block to fill, its transactions are allocated
+ * Return: 1 on success else 0 if the payload is malformed
+ */
+int decodeBlock(const record_t *record, block_t *block)
+{
+    const unsigned char *p = record->data;
+    int nb_trans;
+
+    if (record->len < BLOCK_RECORD_HEADER_SIZE)
+        return 0;
+    memcpy(&block->index, p, sizeof(block->index));
+    p += sizeof(block->index);
+    memcpy(&block->timestamp, p, sizeof(block->timestamp));
+    p += sizeof(block->timestamp);
+    memcpy(&block->nonce, p, sizeof(block->nonce));
+    p += sizeof(block->nonce);
+    memcpy(block->prevHash, p, SHA256_DIGEST_LENGTH);
+    p += SHA256_DIGEST_LENGTH;
+    memcpy(block->currHash, p, SHA256_DIGEST_LENGTH);
+    p += SHA256_DIGEST_LENGTH;
+    memcpy(&nb_trans, p, sizeof(nb_trans));
+    p += sizeof(nb_trans);
+
+    if (nb_trans < 0 ||
+        record->len != BLOCK_RECORD_HEADER_SIZE + (size_t)nb_trans * TRANSACTION_RECORD_SIZE)
+        return 0;
+    block->transactions = newTransactions(nb_trans);
+    if (!block->transactions)
+        return 0;
+    for (int i = 0; i < nb_trans; i++, p += TRANSACTION_RECORD_SIZE)
+        decodeTransaction(p, block->transactions);
+    return 1;
+}
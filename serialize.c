@@ -2,52 +2,28 @@
 
 /**
  * serializeBlockchain - serializes a blockchain to a file
+ * @ctx: pointer to context
  * @blockchain: pointer to blockchain to serialize
+ *
+ * Each block is written as one CRC32C framed record. The file is replaced
+ * atomically, so concurrent readers see either the old or the new chain.
+ * The chain stays owned by the caller.
  * Return: 1 on success else 0 on failure
  */
-int serializeBlockchain(Blockchain *blockchain)
+int serializeBlockchain(blockchain_ctx_t *ctx, Blockchain *blockchain)
 {
-    FILE *file = fopen(BLOCKCHAIN_DATABASE, "wb");
+    record_t record = {0};
+    snapshot_t snapshot;
+    int ok;
+
+    FILE *file = beginSnapshot(&snapshot, ctx->chain_path);
     if (!file)
-    {
-        printf("Failed to open file for serialization\n");
         return 0;
-    }
-
-    fwrite(&blockchain->difficulty, sizeof(blockchain->difficulty), 1, file);
-
-    block_t *current = blockchain->head;
-    while (current) {
-        fwrite(&current->index, sizeof(current->index), 1, file);
-        fwrite(&current->timestamp, sizeof(current->timestamp), 1, file);
-        fwrite(&current->nonce, sizeof(current->nonce), 1, file);
-        fwrite(current->prevHash, SHA256_DIGEST_LENGTH, 1, file);
-        fwrite(current->currHash, SHA256_DIGEST_LENGTH, 1, file);
-
-         if (current->transactions)
-        {
-            fwrite(&current->transactions->nb_trans, sizeof(current->transactions->nb_trans), 1, file);
-
-            transaction_t *trans = current->transactions->head;
-            while (trans)
-            {
-                fwrite(&trans->index, sizeof(trans->index), 1, file);
-                fwrite(trans->sender, sizeof(trans->sender), 1, file);
-                fwrite(trans->receiver, sizeof(trans->receiver), 1, file);
-                fwrite(trans->amount, sizeof(trans->amount), 1, file);  // Fixed by adding '&'
-                trans = trans->next;
-            }
-        }
-        else
-        {
-            int zero_trans = 0;
-            fwrite(&zero_trans, sizeof(zero_trans), 1, file);
-        }
 
-        current = current->next;
-    }
+    ok = writeFileHeader(file, BLOCKCHAIN_MAGIC, blockchain->difficulty);
+    for (int i = 0; ok && i < blockchain->length; i++)
+        ok = encodeBlock(&record, &blockchain->blocks[i]) && writeRecord(file, &record);
 
-    fclose(file);
-    freeBlockchain(blockchain);
-    return 1;
-}
\ No newline at end of file
+    freeRecord(&record);
+    return commitSnapshot(&snapshot, ok);
+}
@@ -1,149 +1,283 @@
 #include "blockchain.h"
+#include <errno.h>
+
+/**
+ * newTransactions - allocates an empty list of transactions
+ * @capacity: number of transactions to reserve room for
+ * Return: pointer to list or NULL on failure
+ */
+list_of_transactions *newTransactions(int capacity)
+{
+    list_of_transactions *transactions = calloc(1, sizeof(*transactions));
+    if (!transactions)
+    {
+        blockchainFail(BC_ENOMEM);
+        return NULL;
+    }
+    if (capacity > 0 && !reserveTransactions(transactions, capacity))
+    {
+        free(transactions);
+        return NULL;
+    }
+    return transactions;
+}
+
+/**
+ * reserveTransactions - grows the packed arrays of a list
+ * @transactions: pointer to list of transactions
+ * @capacity: minimum number of transactions the list must hold
+ * Return: 1 on success else 0
+ */
+int reserveTransactions(list_of_transactions *transactions, int capacity)
+{
+    transaction_t *trans;
+    transaction_payload_t *payloads;
+    int cap;
+
+    if (capacity <= transactions->capacity)
+        return 1;
+    cap = transactions->capacity ? transactions->capacity : 4;
+    while (cap < capacity)
+        cap *= 2;
+
+    trans = realloc(transactions->trans, cap * sizeof(*trans));
+    if (!trans)
+        return blockchainFail(BC_ENOMEM);
+    transactions->trans = trans;
+    payloads = realloc(transactions->payloads, cap * sizeof(*payloads));
+    if (!payloads)
+        return blockchainFail(BC_ENOMEM);
+    transactions->payloads = payloads;
+    transactions->capacity = cap;
+    return 1;
+}
+
+/**
+ * appendTransaction - adds a transaction at the end of a list
+ * @transactions: pointer to list of transactions
+ * @sender: sender details
+ * @receiver: receiver details
+ * @amount: amount of transaction
+ * @fee: transaction fee, its priority in the pool
+ * Return: 1 on success else 0
+ */
+int appendTransaction(list_of_transactions *transactions, const char *sender, const char *receiver, const char *amount, uint64_t fee)
+{
+    transaction_t *trans;
+    transaction_payload_t *payload;
+
+    if (!reserveTransactions(transactions, transactions->nb_trans + 1))
+        return 0;
+    trans = &transactions->trans[transactions->nb_trans];
+    payload = &transactions->payloads[transactions->nb_trans];
+
+    trans->index = transactions->nb_trans;
+    trans->fee = fee;
+    strncpy(payload->sender, sender, DATASIZE_MAX - 1);
+    payload->sender[DATASIZE_MAX - 1] = '\0';
+    strncpy(payload->receiver, receiver, DATASIZE_MAX - 1);
+    payload->receiver[DATASIZE_MAX - 1] = '\0';
+    strncpy(trans->amount, amount, sizeof(trans->amount) - 1);
+    trans->amount[sizeof(trans->amount) - 1] = '\0';
+    payload->admitted = 0;
+
+    transactions->nb_trans++;
+    return 1;
+}
+
 /**
  * serializeUnspent - serialize unspent transactions to a file
+ * @ctx: pointer to context
  * @unspent: pointer to list of unspent transactions
+ * @next_index: admission sequence of the next pool entry
+ *
+ * The file is replaced atomically, so readers never see a partial pool.
  * Return: 1 on sucess else 0 on failure
  */
-int serializeUnspent(list_of_transactions *unspent)
+int serializeUnspent(blockchain_ctx_t *ctx, list_of_transactions *unspent, int32_t next_index)
 {
-    FILE *file = fopen(TRANSACTION_DATABASE, "wb");
+    record_t record = {0};
+    snapshot_t snapshot;
+    int ok;
+
+    FILE *file = beginSnapshot(&snapshot, ctx->pool_path);
     if (!file)
-    {
-        printf("Failed to open file for serialization\n");
-        fclose(file);
         return 0;
-    }
-    transaction_t *current = unspent->head;
-    while (current)
+    ok = writeFileHeader(file, TRANSACTION_MAGIC, next_index);
+    for (int i = 0; ok && i < unspent->nb_trans; i++)
     {
-        fwrite(&current->index, sizeof(current->index), 1, file);
-        fwrite(current->sender, sizeof(current->sender), 1, file);
-        fwrite(current->receiver, sizeof(current->receiver), 1, file);
-        fwrite(current->amount, sizeof(current->amount), 1, file);
-        current = current->next;
+        record.len = 0;
+        ok = encodeTransaction(&record, unspent, i) && writeRecord(file, &record);
     }
-    fclose(file);
-    return 1;
+    freeRecord(&record);
+    return commitSnapshot(&snapshot, ok);
 }
 
 /**
  * deserializeUnspent - get unpsent transactions from pool(file)
- * Return: pointer to list of unpsent transactions else exit
+ *
+ * Every record is checked against its CRC32C. A bad header or a truncated
+ * or corrupt record is reported and fails the load with BC_ECORRUPT, so
+ * the pool is never written back shortened; with ctx->salvage set, the
+ * transactions before it are kept instead.
+ * @ctx: pointer to context
+ * @next_index: pointer to address to store the admission sequence of the
+ * next pool entry, or NULL
+ * Return: pointer to list of unpsent transactions, empty if there is no
+ * pool file yet, or NULL on failure
  */
-list_of_transactions *deserializeUnspent(void)
+list_of_transactions *deserializeUnspent(blockchain_ctx_t *ctx, int32_t *next_index)
 {
-    FILE *file = fopen(TRANSACTION_DATABASE, "rb");
+    record_t record = {0};
+    int32_t header_index = 0;
+    int status, failed = 0;
+
+    FILE *file = fopen(ctx->pool_path, "rb");
     if (!file) {
-        perror("Failed to open file for deserialization of unpsent transactions");
-        return NULL;
+        if (errno != ENOENT) {
+            blockchainFail(BC_EIO);
+            return NULL;
+        }
+        if (next_index)
+            *next_index = 0;
+        return newTransactions(0);
     }
 
-    list_of_transactions *unspent_transactions = (list_of_transactions *)malloc(sizeof(list_of_transactions));
+    list_of_transactions *unspent_transactions = newTransactions(0);
     if (!unspent_transactions) {
-        perror("Failed to allocate memory for unspent transactions");
         fclose(file);
         return NULL;
     }
-    
-    unspent_transactions->head = unspent_transactions->tail = NULL;
-    unspent_transactions->nb_trans = 0;
 
-    while (!feof(file))
+    status = readFileHeader(file, TRANSACTION_MAGIC, &header_index);
+    if (next_index)
+        *next_index = header_index;
+    if (status != RECORD_OK && status != RECORD_END)
+    {
+        logContext(ctx, "%s: %s in file header\n", ctx->pool_path, recordError(status));
+        failed = !ctx->salvage;
+    }
+    while (status == RECORD_OK)
     {
-        transaction_t *transaction = (transaction_t *)malloc(sizeof(transaction_t));
-        if (!transaction)
+        long offset = ftell(file);
+        status = readRecord(file, &record);
+        if (status == RECORD_OK && record.len != TRANSACTION_RECORD_SIZE)
+            status = RECORD_CORRUPT;
+        if (status == RECORD_OK)
+            decodeTransaction(record.data, unspent_transactions);
+        else if (status != RECORD_END)
         {
-            perror("Failed to allocate memory for transaction");
-            fclose(file);
-            free(unspent_transactions);
-            return NULL;
-        }
-
-        if (fread(&transaction->index, sizeof(transaction->index), 1, file) != 1) {
-            free(transaction);
-            break;
-        }
-        fread(transaction->sender, sizeof(transaction->sender), 1, file);
-        fread(transaction->receiver, sizeof(transaction->receiver), 1, file);
-        fread(transaction->amount, sizeof(transaction->amount), 1, file);
-
-        transaction->next = NULL;
-        if (unspent_transactions->head == NULL) {
-            unspent_transactions->head = unspent_transactions->tail = transaction;
-        } else {
-            unspent_transactions->tail->next = transaction;
-            unspent_transactions->tail = transaction;
+            logContext(ctx, "%s: %s at offset %ld, after %d good transactions\n",
+                       ctx->pool_path, recordError(status), offset, unspent_transactions->nb_trans);
+            failed = !ctx->salvage;
         }
-
-        unspent_transactions->nb_trans++;
     }
 
+    freeRecord(&record);
     fclose(file);
+    if (failed)
+    {
+        freeTransactions(unspent_transactions);
+        blockchainFail(BC_ECORRUPT);
+        return NULL;
+    }
     return unspent_transactions;
 }
 
 /**
  * addTransactionToUnspent - adds transaction to unspent transactions pool(file)
+ * @ctx: pointer to context
  * @sender: sender details
  * @receiver: receiver details
  * @amount: amount of transaction
- * Return: 1 on success or 0 on failure
+ * @fee: transaction fee, higher fees are mined first
+ *
+ * The transaction is pushed into the shared submission queue and drained
+ * to the pool file by a single process at a time. When the queue is full
+ * or unavailable it is admitted directly under the pool lock instead.
+ * Admission into a full pool evicts its lowest fee entry, or drops the
+ * transaction if it has the lowest fee.
+ * Return: 1 if admitted, 2 if still queued behind a stalled submission, or
+ * 0 on failure, BC_EREJECTED if dropped
  */
-int addTransactionToUnspent(const char *sender, const char *receiver, const char *amount)
+int addTransactionToUnspent(blockchain_ctx_t *ctx, const char *sender, const char *receiver, const char *amount, uint64_t fee)
 {
-    list_of_transactions *unspent;
-    transaction_t *new_trans;
+    tx_pool_t *pool;
+    uint64_t position;
+    int fd, admitted;
+
     if (!sender || !receiver || !amount)
-    {
-        fprintf(stderr, "Wrong details\n");
-        return 0;
-    }
+        return blockchainFail(BC_EINVAL);
 
-    unspent = deserializeUnspent();
-    if (!unspent)
+    if (enqueueTransaction(ctx, sender, receiver, amount, fee, &position))
     {
-        fprintf(stderr, "Error deserializing unspent transactions\n");
-        return 0;
+        flushTransactionQueue(ctx);
+        admitted = queueOutcome(ctx, position);
+        if (admitted < 0)
+        {
+            /* Another process holds the lock: wait for it, then drain */
+            fd = lockUnspent(ctx, 1);
+            if (fd < 0)
+                return 0;
+            if (!drainTransactionQueue(ctx))
+            {
+                int error = blockchainError();
+                unlockUnspent(ctx, fd);
+                logContext(ctx, "Transaction queued, but the pool could not be updated\n");
+                return blockchainFail(error);
+            }
+            unlockUnspent(ctx, fd);
+            admitted = queueOutcome(ctx, position);
+        }
+        if (admitted == 0)
+            return blockchainFail(BC_EREJECTED);
+        if (admitted < 0)
+            logContext(ctx, "Transaction queued but not in the pool yet\n");
+        return admitted > 0 ? 1 : 2;
     }
 
-    new_trans = (transaction_t *)malloc(sizeof(transaction_t));
-     if (!new_trans)
-    {
-        fprintf(stderr, "Failed to allocate memory for new transaction\n");
-        free(unspent);
+    fd = lockUnspent(ctx, 1);
+    if (fd < 0)
         return 0;
-    }
-    new_trans->index = unspent->nb_trans;
-    unspent->nb_trans++;
-
-    strncpy(new_trans->sender, sender, DATASIZE_MAX - 1);
-    new_trans->sender[DATASIZE_MAX - 1] = '\0';
-    strncpy(new_trans->receiver, receiver, DATASIZE_MAX - 1);
-    new_trans->receiver[DATASIZE_MAX - 1] = '\0';
-    strncpy(new_trans->amount, amount, sizeof(new_trans->amount) - 1);
-    new_trans->amount[sizeof(new_trans->amount) - 1] = '\0';
-    new_trans->next = NULL;
-
-    if (!unspent->head)
-        unspent->head = unspent->tail = new_trans;
-    else
-    {
-        unspent->tail->next = new_trans;
-        unspent->tail = new_trans;
-    }
 
-    if (!serializeUnspent(unspent))
+    /* Keep submission order: anything already queued goes first */
+    drainTransactionQueue(ctx);
+    pool = loadPool(ctx);
+    if (!pool)
     {
-        fprintf(stderr, "Could not serialize unspent with new transaction\n");
-        free(new_trans);
-        free(unspent);
+        unlockUnspent(ctx, fd);
         return 0;
     }
 
-    printf("Transaction saved!\n");
-    free(new_trans);
-    free(unspent);
-    return 1;
+    admitted = poolAdmit(pool, sender, receiver, amount, fee, latencyNow());
+    if (admitted == 0)
+        blockchainFail(BC_EREJECTED);
+    else if (admitted > 0 && !savePool(pool))
+        admitted = 0;
+    freePool(pool);
+    unlockUnspent(ctx, fd);
+    return admitted > 0;
+}
+
+/**
+ * removeFromUnspent - drops mined transactions from the pool; caller must
+ * hold the pool lock
+ * @ctx: pointer to context
+ * @indices: pool indices of the mined transactions
+ * @count: number of indices
+ * Return: 1 on success or 0 on failure
+ */
+int removeFromUnspent(blockchain_ctx_t *ctx, int *indices, int count)
+{
+    tx_pool_t *pool = loadPool(ctx);
+    int ok;
+
+    if (!pool)
+        return 0;
+    poolRemoveIndices(pool, indices, count);
+    ok = savePool(pool);
+    freePool(pool);
+    return ok;
 }
 
 /**
@@ -154,12 +288,7 @@ void freeTransactions(list_of_transactions *transactions)
 {
     if(!transactions)
         return;
-    transaction_t *current = transactions->head;
-    while (current)
-    {
-        transaction_t *next = current->next;
-        free(current);
-        current = next;
-    }
+    free(transactions->trans);
+    free(transactions->payloads);
     free(transactions);
-}
\ No newline at end of file
+}
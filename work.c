@@ -0,0 +1,427 @@
+#include "blockchain.h"
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * Get-work/submit-work protocol spoken over a local stream socket.
+ * Every message is a work_header_t followed by len payload bytes:
+ *   GET_WORK  worker -> coordinator  (empty), also means the last range is done
+ *   WORK      coordinator -> worker  work_template_t + encodeBlock() record
+ *   SUBMIT    worker -> coordinator  work_submit_t
+ *   DONE      coordinator -> worker  (empty), the block has been found
+ */
+#define MSG_GET_WORK 1
+#define MSG_WORK 2
+#define MSG_SUBMIT 3
+#define MSG_DONE 4
+
+#define WORKER_POLL_INTERVAL 65536  /* Hashes between checks for a stale job */
+
+typedef struct work_header_s {
+    uint32_t type;
+    uint32_t len;
+} work_header_t;
+
+typedef struct work_template_s {
+    uint64_t job;    /* changes whenever the block header changes */
+    uint64_t start;  /* first nonce of the range */
+    uint64_t end;    /* one past the last nonce, 0 when the range ends at 2^64 */
+    int32_t difficulty;
+    int32_t reserved;
+} work_template_t;
+
+typedef struct work_submit_s {
+    uint64_t job;
+    uint64_t nonce;
+} work_submit_t;
+
+typedef struct worker_conn_s {
+    int fd;
+    int busy;  /* holds an unfinished range */
+    uint64_t start;
+    uint64_t end;
+} worker_conn_t;
+
+typedef struct nonce_range_s {
+    uint64_t start;
+    uint64_t end;
+} nonce_range_t;
+
+static int writeAll(int fd, const void *buf, size_t len)
+{
+    const unsigned char *p = buf;
+    while (len)
+    {
+        /* MSG_NOSIGNAL: a vanished peer is an error here, not a SIGPIPE */
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+static int readAll(int fd, void *buf, size_t len)
+{
+    unsigned char *p = buf;
+    while (len)
+    {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+/**
+ * sendMessage - sends a message made of up to two payload parts
+ * @fd: socket
+ * @type: MSG_* type
+ * @a: first payload part or NULL
+ * @alen: length of a
+ * @b: second payload part or NULL
+ * @blen: length of b
+ * Return: 1 on success else 0
+ */
+static int sendMessage(int fd, uint32_t type, const void *a, size_t alen, const void *b, size_t blen)
+{
+    work_header_t header;
+
+    header.type = type;
+    header.len = (uint32_t)(alen + blen);
+    return writeAll(fd, &header, sizeof(header)) &&
+           (!alen || writeAll(fd, a, alen)) &&
+           (!blen || writeAll(fd, b, blen));
+}
+
+/**
+ * recvMessage - receives a message
+ * @fd: socket
+ * @type: pointer to address to store MSG_* type
+ * @payload: pointer to record buffer receiving the payload
+ * Return: 1 on success else 0 on EOF or error
+ */
+static int recvMessage(int fd, uint32_t *type, record_t *payload)
+{
+    work_header_t header;
+
+    if (!readAll(fd, &header, sizeof(header)) || header.len > RECORD_MAX ||
+        !reserveRecord(payload, header.len) || !readAll(fd, payload->data, header.len))
+        return 0;
+    *type = header.type;
+    payload->len = header.len;
+    return 1;
+}
+
+/**
+ * listenSocket - binds the coordinator socket
+ * @path: socket path
+ * Return: listening descriptor or -1 on failure
+ */
+static int listenSocket(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, MAX_WORKERS) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * coordinateMining - serves a block template to worker processes until one
+ * of them submits a nonce meeting the difficulty
+ * @ctx: pointer to context, whose socket workers connect to
+ * @block: pointer to block template, nonce and currHash are set on success
+ * @difficulty: PoW difficulty level
+ *
+ * Workers claim disjoint WORK_RANGE slices of the nonce space. A range
+ * held by a worker that disconnects is handed out again. Each submission
+ * is checked with calculateHash() before being accepted. Once the whole
+ * nonce space is handed out the timestamp is rolled and a new job starts.
+ * Return: 1 when the block is solved else 0
+ */
+int coordinateMining(blockchain_ctx_t *ctx, block_t *block, int difficulty)
+{
+    const char *path = ctx->socket_path;
+    worker_conn_t workers[MAX_WORKERS];
+    nonce_range_t reissue[MAX_WORKERS];
+    struct pollfd fds[MAX_WORKERS + 1];
+    record_t encoded = {0}, message = {0};
+    work_template_t tmpl;
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    uint64_t job = 1, next = 0;
+    int nb_workers = 0, nb_reissue = 0, solved = 0, failed = 0;
+    int listener;
+
+    listener = listenSocket(path);
+    if (listener < 0)
+        return blockchainFail(BC_EIO);
+    if (!encodeBlock(&encoded, block))
+    {
+        close(listener);
+        unlink(path);
+        return 0;
+    }
+
+    logContext(ctx, "Waiting for workers on %s to mine block %d at difficulty %d...\n", path, block->index, difficulty);
+
+    while (!solved && !failed)
+    {
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        for (int i = 0; i < nb_workers; i++)
+        {
+            fds[i + 1].fd = workers[i].fd;
+            fds[i + 1].events = POLLIN;
+        }
+        if (poll(fds, nb_workers + 1, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (int i = nb_workers - 1; i >= 0 && !solved && !failed; i--)
+        {
+            uint32_t type;
+            worker_conn_t *w = &workers[i];
+
+            if (!(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            if (!recvMessage(w->fd, &type, &message))
+            {
+                /* Worker gone: its range goes back to the pool */
+                if (w->busy)
+                {
+                    reissue[nb_reissue].start = w->start;
+                    reissue[nb_reissue++].end = w->end;
+                }
+                close(w->fd);
+                workers[i] = workers[--nb_workers];
+                continue;
+            }
+
+            if (type == MSG_SUBMIT && message.len == sizeof(work_submit_t))
+            {
+                work_submit_t submit;
+                memcpy(&submit, message.data, sizeof(submit));
+                if (submit.job != job)
+                    continue;
+                if (calculateHash(block, submit.nonce, hash) && is_valid_hash(hash, difficulty))
+                {
+                    block->nonce = submit.nonce;
+                    memcpy(block->currHash, hash, SHA256_DIGEST_LENGTH);
+                    solved = 1;
+                }
+                else
+                    logContext(ctx, "Rejected invalid nonce %" PRIu64 "\n", submit.nonce);
+            }
+            else if (type == MSG_GET_WORK)
+            {
+                if (nb_reissue)
+                {
+                    w->start = reissue[--nb_reissue].start;
+                    w->end = reissue[nb_reissue].end;
+                }
+                else
+                {
+                    w->start = next;
+                    w->end = next += WORK_RANGE;
+                    if (next == 0)
+                    {
+                        /* Nonce space handed out: new job with a rolled timestamp */
+                        uint64_t now = (uint64_t)time(NULL);
+                        block->timestamp = now > block->timestamp ? now : block->timestamp + 1;
+                        job++;
+                        nb_reissue = 0;
+                        if (!encodeBlock(&encoded, block))
+                        {
+                            failed = 1;
+                            break;
+                        }
+                    }
+                }
+                w->busy = 1;
+                tmpl.job = job;
+                tmpl.start = w->start;
+                tmpl.end = w->end;
+                tmpl.difficulty = difficulty;
+                tmpl.reserved = 0;
+                sendMessage(w->fd, MSG_WORK, &tmpl, sizeof(tmpl), encoded.data, encoded.len);
+            }
+        }
+
+        if (!failed && fds[0].revents & POLLIN)
+        {
+            int fd = accept(listener, NULL, NULL);
+            if (fd >= 0 && nb_workers < MAX_WORKERS)
+            {
+                workers[nb_workers].fd = fd;
+                workers[nb_workers++].busy = 0;
+            }
+            else if (fd >= 0)
+                close(fd);
+        }
+    }
+
+    for (int i = 0; i < nb_workers; i++)
+    {
+        sendMessage(workers[i].fd, MSG_DONE, NULL, 0, NULL, 0);
+        close(workers[i].fd);
+    }
+    close(listener);
+    unlink(path);
+    freeRecord(&encoded);
+    freeRecord(&message);
+
+    if (solved)
+        logContext(ctx, "Block %d mined with nonce: %" PRIu64 "\n", block->index, block->nonce);
+    if (failed)
+        return 0;
+    return solved || blockchainFail(BC_EIO);
+}
+
+/**
+ * connectSocket - connects to the coordinator
+ * @path: socket path
+ * Return: connected descriptor or -1 on failure
+ */
+static int connectSocket(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * searchRange - hashes a nonce range of a block template
+ * @fd: coordinator socket, polled so a solved job is abandoned early
+ * @block: pointer to block template
+ * @tmpl: pointer to range and difficulty
+ * @nonce: pointer to address to store the solution
+ * Return: 1 if found, 0 if the range was exhausted, -1 if the coordinator
+ * has something to say (usually DONE) or went away or hashing failed
+ */
+static int searchRange(int fd, block_t *block, const work_template_t *tmpl, uint64_t *nonce)
+{
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    for (uint64_t n = tmpl->start; n != tmpl->end; n++)
+    {
+        if (!calculateHash(block, n, hash))
+            return -1;
+        if (is_valid_hash(hash, tmpl->difficulty))
+        {
+            *nonce = n;
+            return 1;
+        }
+        if ((n - tmpl->start) % WORKER_POLL_INTERVAL == WORKER_POLL_INTERVAL - 1 &&
+            poll(&pfd, 1, 0) > 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * workMining - worker loop: claims nonce ranges from the coordinator,
+ * searches them and submits solutions
+ * @ctx: pointer to context, whose socket the coordinator listens on
+ * @once: 1 to return after the first coordinator finishes, 0 to keep
+ * reconnecting for the next block
+ * Return: 1 on a clean stop, 0 on failure
+ */
+int workMining(blockchain_ctx_t *ctx, int once)
+{
+    const char *path = ctx->socket_path;
+    record_t message = {0};
+    work_template_t tmpl;
+    block_t block;
+    uint32_t type;
+    uint64_t nonce;
+
+    if (strlen(path) >= sizeof(((struct sockaddr_un *)0)->sun_path))
+        return blockchainFail(BC_EINVAL);
+    for (;;)
+    {
+        int fd = connectSocket(path);
+        if (fd < 0)
+        {
+            sleep(1);
+            continue;
+        }
+
+        while (sendMessage(fd, MSG_GET_WORK, NULL, 0, NULL, 0) &&
+               recvMessage(fd, &type, &message) && type == MSG_WORK &&
+               message.len >= sizeof(tmpl))
+        {
+            record_t encoded;
+            int found;
+
+            memcpy(&tmpl, message.data, sizeof(tmpl));
+            encoded.data = message.data + sizeof(tmpl);
+            encoded.len = message.len - sizeof(tmpl);
+            encoded.cap = encoded.len;
+            if (!decodeBlock(&encoded, &block))
+                break;
+
+            found = searchRange(fd, &block, &tmpl, &nonce);
+            freeTransactions(block.transactions);
+            if (found < 0)
+                break;
+            if (found)
+            {
+                work_submit_t submit;
+                submit.job = tmpl.job;
+                submit.nonce = nonce;
+                logContext(ctx, "Found nonce %" PRIu64 " for block %d\n", nonce, block.index);
+                if (!sendMessage(fd, MSG_SUBMIT, &submit, sizeof(submit), NULL, 0))
+                    break;
+            }
+        }
+        close(fd);
+        if (once)
+            break;
+    }
+    freeRecord(&message);
+    return 1;
+}